@@ -1,11 +1,13 @@
 #include <assert.h>
 #include <math.h>
 #include <stdio.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
 //#define DEBUG
 #include "board.h"
+#include "board_spec.h"
 #include "debug.h"
 #include "fbook.h"
 #include "mq.h"
@@ -17,19 +19,9 @@
 #include "pattern3.h"
 #endif
 
-#if 0
-#define profiling_noinline __attribute__((noinline))
-#else
-#define profiling_noinline
-#endif
-
 #define gi_granularity 4
 #define gi_allocsize(gids) ((1 << gi_granularity) + ((gids) >> gi_granularity) * (1 << gi_granularity))
 
-static int  board_play_f(board_t *board, move_t *m, int f);
-static void board_addf(board_t *b, coord_t c);
-static void board_rmf(board_t *b, int f);
-
 
 static void
 board_setup(board_t *b)
@@ -66,13 +58,57 @@ board_delete(board_t **b)
 int
 board_cmp(board_t *b1, board_t *b2)
 {
-	return memcmp(b1, b2, sizeof(board_t));
+	/* Same parts as board_copy(). */
+	int max_coords = board_max_coords(b1);
+	int r;
+#define cmp_map(field, n)  if ((r = memcmp(b1->field, b2->field, (n) * sizeof(b1->field[0]))))  return r
+	if ((r = memcmp(b1, b2, offsetof(board_t, b))))  return r;
+	cmp_map(b, max_coords);
+	cmp_map(n, max_coords);
+	cmp_map(g, max_coords);
+	cmp_map(p, max_coords);
+	cmp_map(gi, max_coords);
+#ifdef BOARD_PAT3
+	cmp_map(pat3, max_coords);
+#endif
+	cmp_map(f, b1->flen);
+	cmp_map(fmap, max_coords);
+#ifdef WANT_BOARD_C
+	cmp_map(c, b1->clen);
+#endif
+#ifdef DCNN_DARKFOREST
+	cmp_map(moveno, max_coords);
+#endif
+#undef cmp_map
+	return 0;
 }
 
 void
 board_copy(board_t *b2, board_t *b1)
 {
-	memcpy(b2, b1, sizeof(board_t));
+	/* Goban maps are sized for the largest board, only copy the part
+	 * in use (and used part of the lists). On 9x9 this is a fraction
+	 * of sizeof(board_t), and it's done for every playout. */
+	int max_coords = board_max_coords(b1);
+#define copy_map(field, n)  memcpy(b2->field, b1->field, (n) * sizeof(b1->field[0]))
+	memcpy(b2, b1, offsetof(board_t, b));
+	copy_map(b, max_coords);
+	copy_map(n, max_coords);
+	copy_map(g, max_coords);
+	copy_map(p, max_coords);
+	copy_map(gi, max_coords);
+#ifdef BOARD_PAT3
+	copy_map(pat3, max_coords);
+#endif
+	copy_map(f, b1->flen);
+	copy_map(fmap, max_coords);
+#ifdef WANT_BOARD_C
+	copy_map(c, b1->clen);
+#endif
+#ifdef DCNN_DARKFOREST
+	copy_map(moveno, max_coords);
+#endif
+#undef copy_map
 
 	// XXX: Special semantics.
 	b2->fbook = NULL;
@@ -98,6 +134,24 @@ board_resize(board_t *board, int size)
 
 board_statics_t board_statics = { 0, };
 
+/* Hot board code for current board size, see board_spec.h */
+static board_impl_t board_impl = board_impl_init(generic);
+
+static void
+board_impl_select(int size)
+{
+	board_impl = (board_impl_t) board_impl_init(generic);
+#ifndef BOARD_SIZE
+	switch (size) {
+		case 9:   board_impl = (board_impl_t) board_impl_init(9);   break;
+		case 13:  board_impl = (board_impl_t) board_impl_init(13);  break;
+		case 19:  board_impl = (board_impl_t) board_impl_init(19);  break;
+	}
+#endif
+	if (DEBUGL(3))  fprintf(stderr, "board: using %s %ix%i code\n",
+				(board_impl.play == board_play_generic ? "generic" : "specialized"), size, size);
+}
+
 static void
 board_statics_init(board_t *board)
 {
@@ -110,6 +164,7 @@ board_statics_init(board_t *board)
 	memset(bs, 0, sizeof(*bs));
 	bs->rsize = size;
 	bs->stride = stride;
+	board_impl_select(size);
 	bs->max_coords = stride * stride;
 
 	bs->bits2 = 1;
@@ -209,8 +264,10 @@ board_init_data(board_t *board)
 
 	/* All positions are free! Except the margin. */
 	foreach_point(board) {
-		if (board_at(board, c) == S_NONE)
-			board_addf(board, c);
+		if (board_at(board, c) == S_NONE) {
+			board->fmap[c] = board->flen;
+			board->f[board->flen++] = c;
+		}
 	} foreach_point_end;
 	assert(board->flen == size * size);
 
@@ -544,38 +601,28 @@ board_permit(board_t *b, move_t *m, void *data)
 	return true;
 }
 
-static inline bool
-board_try_random_move(board_t *b, enum stone color, coord_t *coord, int f, ppr_permit permit, void *permit_data)
+int
+board_play(board_t *b, move_t *m)
 {
-	*coord = b->f[f];
-	move_t m = { *coord, color };
-	if (DEBUGL(6))
-		fprintf(stderr, "trying random move %d: %d,%d %s %d\n", f, coord_x(*coord), coord_y(*coord), coord2sstr(*coord), board_is_valid_move(b, &m));
-	permit = (permit ? permit : board_permit);
-	if (!permit(b, &m, permit_data))
-		return false;
-	if (m.coord == *coord)
-		return likely(board_play_f(b, &m, f) >= 0);
-	*coord = m.coord; // permit modified the coordinate
-	return likely(board_play(b, &m) >= 0);
+	return board_impl.play(b, m);
 }
 
 void
 board_play_random(board_t *b, enum stone color, coord_t *coord, ppr_permit permit, void *permit_data)
 {
-	if (likely(b->flen)) {
-		int base = fast_random(b->flen), f;
-		for (f = base; f < b->flen; f++)
-			if (board_try_random_move(b, color, coord, f, permit, permit_data))
-				return;
-		for (f = 0; f < base; f++)
-			if (board_try_random_move(b, color, coord, f, permit, permit_data))
-				return;
-	}
+	board_impl.play_random(b, color, coord, permit, permit_data);
+}
+
+int
+board_quick_play(board_t *b, move_t *m, board_undo_t *u)
+{
+	return board_impl.quick_play(b, m, u);
+}
 
-	*coord = pass;
-	move_t m = { pass, color };
-	board_play(b, &m);
+void
+board_quick_undo(board_t *b, move_t *m, board_undo_t *u)
+{
+	board_impl.quick_undo(b, m, u);
 }
 
 
@@ -606,6 +653,33 @@ board_is_one_point_eye(board_t *b, coord_t c, enum stone eye_color)
 		!board_is_false_eyelike(b, c, eye_color));
 }
 
+int
+board_group_libs_exact(board_t *b, group_t g)
+{
+	group_info_t *gi = &board_group_info(b, g);
+#ifdef BOARD_LIBSET
+	int libs = 0;
+	for (int i = 0; i < LIBSET_WORDS; i++)
+		libs += __builtin_popcountll(gi->libset[i]);
+	return libs;
+#else
+	if (gi->libs <= GROUP_REFILL_LIBS)
+		return gi->libs;
+
+	int libs = 0;
+	unsigned char watermark[BOARD_MAX_COORDS / 8 + 1] = { 0, };
+	foreach_in_group(b, g) {
+		foreach_neighbor(b, c, {
+			if (board_at(b, c) != S_NONE || watermark[c >> 3] & (1 << (c & 7)))
+				continue;
+			watermark[c >> 3] |= 1 << (c & 7);
+			libs++;
+		});
+	} foreach_in_group_end;
+	return libs;
+#endif
+}
+
 enum stone
 board_eye_color(board_t *b, coord_t c)
 {
@@ -837,187 +911,3 @@ rules2str(enum rules rules)
 	}
 	return NULL;
 }
-
-
-/********************************************************************************************************/
-/* board_play() implementation */
-
-static inline void
-board_addf(board_t *b, coord_t c)
-{
-	b->fmap[c] = b->flen; 
-	b->f[b->flen++] = c;
-}
-
-static inline void
-board_rmf(board_t *b, int f)
-{
-	/* Not bothering to delete fmap records,
-	 * Just keep the valid ones up to date. */
-	coord_t c = b->f[f] = b->f[--b->flen];
-	b->fmap[c] = f;
-}
-
-static void
-board_commit_move(board_t *b, move_t *m)
-{
-	if (!playout_board(b)) {
-#ifdef DCNN_DARKFOREST
-		if (darkforest_dcnn && !is_pass(m->coord))
-			b->moveno[m->coord] = b->moves;
-#endif
-	}
-
-	b->last_move_i = last_move_nexti(b);
-	last_move(b) = *m;
-
-	b->moves++;
-}
-
-/* Update board hash with given coordinate. */
-static void profiling_noinline
-board_hash_update(board_t *board, coord_t coord, enum stone color)
-{
-	if (!playout_board(board)) {
-		board->hash ^= hash_at(coord, color);
-		if (DEBUGL(8))
-			fprintf(stderr, "board_hash_update(%d,%d,%d) ^ %" PRIhash " -> %" PRIhash "\n", color, coord_x(coord), coord_y(coord), hash_at(coord, color), board->hash);
-	}
-
-#if defined(BOARD_PAT3)
-	/* @color is not what we need in case of capture. */
-	static const int ataribits[8] = { -1, 0, -1, 1, 2, -1, 3, -1 };
-	enum stone new_color = board_at(board, coord);
-	bool in_atari = false;
-	if (new_color == S_NONE)
-		board->pat3[coord] = pattern3_hash(board, coord);
-	else
-		in_atari = (board_group_info(board, group_at(board, coord)).libs == 1);
-	foreach_8neighbor(board, coord) {
-		/* Internally, the loop uses fn__i=[0..7]. We can use
-		 * it directly to address bits within the bitmap of the
-		 * neighbors since the bitmap order is reverse to the
-		 * loop order. */
-		if (board_at(board, c) != S_NONE)
-			continue;
-		board->pat3[c] &= ~(3 << (fn__i*2));
-		board->pat3[c] |= new_color << (fn__i*2);
-		if (ataribits[fn__i] >= 0) {
-			board->pat3[c] &= ~(1 << (16 + ataribits[fn__i]));
-			board->pat3[c] |= in_atari << (16 + ataribits[fn__i]);
-		}
-	} foreach_8neighbor_end;
-#endif
-}
-
-/* Commit current board hash to history. */
-static void profiling_noinline
-board_hash_commit(board_t *b)
-{
-	if (playout_board(b))  return;
-
-	if (DEBUGL(8)) fprintf(stderr, "board_hash_commit %" PRIhash "\n", b->hash);
-
-	for (int i = 0; i < BOARD_HASH_HISTORY; i++) {
-		if (b->hash_history[i] == b->hash) {
-			if (DEBUGL(5))  fprintf(stderr, "SUPERKO VIOLATION noted at %s\n", coord2sstr(last_move(b).coord));
-			b->superko_violation = true;
-			return;
-		}
-	}
-
-	int i = b->hash_history_next;
-	b->hash_history[i] = b->hash;
-	b->hash_history_next = (i+1) % BOARD_HASH_HISTORY;
-}
-
-static inline void
-board_pat3_reset(board_t *b, coord_t c)
-{
-#ifdef BOARD_PAT3
-	b->pat3[c] = pattern3_hash(b, c);
-#endif
-}
-
-static inline void
-board_pat3_fix(board_t *b, group_t group_from, group_t group_to)
-{
-#ifdef BOARD_PAT3
-	group_info_t *gi_from = &board_group_info(b, group_from);
-	group_info_t *gi_to = &board_group_info(b, group_to);
-	
-	if (gi_to->libs == 1) {
-		coord_t lib = board_group_info(b, group_to).lib[0];
-		if (gi_from->libs == 1) {
-			/* We removed group_from from capturable groups,
-			 * therefore switching the atari flag off.
-			 * We need to set it again since group_to is also
-			 * capturable. */
-			int fn__i = 0;
-			foreach_neighbor(b, lib, {
-				b->pat3[lib] |= (group_at(b, c) == group_from) << (16 + 3 - fn__i);
-				fn__i++;
-			});
-		}
-	}
-#endif /* BOARD_PAT3 */
-}
-
-static void
-board_capturable_add(board_t *board, group_t group, coord_t lib)
-{
-	//fprintf(stderr, "group %s cap %s\n", coord2sstr(group), coord2sstr(lib));
-
-#ifdef BOARD_PAT3
-	int fn__i = 0;
-	foreach_neighbor(board, lib, {
-		board->pat3[lib] |= (group_at(board, c) == group) << (16 + 3 - fn__i);
-		fn__i++;
-	});
-#endif
-
-#ifdef WANT_BOARD_C
-	/* Update the list of capturable groups. */
-	assert(group);
-	assert(board->clen < BOARD_MAX_GROUPS);
-	board->c[board->clen++] = group;
-#endif
-}
-
-static void
-board_capturable_rm(board_t *board, group_t group, coord_t lib)
-{
-	//fprintf(stderr, "group %s nocap %s\n", coord2sstr(group), coord2sstr(lib));
-#ifdef BOARD_PAT3
-	int fn__i = 0;
-	foreach_neighbor(board, lib, {
-		board->pat3[lib] &= ~((group_at(board, c) == group) << (16 + 3 - fn__i));
-		fn__i++;
-	});
-#endif
-
-#ifdef WANT_BOARD_C
-	/* Update the list of capturable groups. */
-	for (int i = 0; i < board->clen; i++)
-		if (unlikely(board->c[i] == group)) {
-			board->c[i] = board->c[--board->clen];
-			return;
-		}
-	fprintf(stderr, "rm of bad group %s\n", coord2sstr(group_base(group)));
-	assert(0);
-#endif
-}
-
-
-#define FULL_BOARD
-#include "board_play.h"
-
-int
-board_play(board_t *b, move_t *m)
-{
-#ifdef BOARD_UNDO_CHECKS
-        assert(!b->quicked);
-#endif
-
-	return board_play_(b, m);
-}
@@ -69,15 +69,25 @@ typedef uint32_t hash3_t;    /* 3x3 pattern hash */
 
 typedef coord_t group_t;     /* Note that "group" is only chain of stones that is solidly connected for us. */
 
+/* Storage types for goban maps: boards get copied for every playout, keep
+ * them small. Coords, group ids and free list indices fit in 16 bits. */
+typedef uint8_t  stone_map_t;
+typedef int16_t  coord_map_t;
+
 
 typedef struct {              /* Keep track of only up to GROUP_KEEP_LIBS. over that, we don't care. */
 #define GROUP_KEEP_LIBS  10   /* _Combination_ of these two values can make some difference in performance. */
 #define GROUP_REFILL_LIBS 5   /* Refill lib[] only when we hit this; this must be at least 2!
 			       * Moggy requires at least 3 - see below for semantic impact. */
-	int libs;             /* libs is only LOWER BOUND for the number of real liberties!!!	
+	int16_t libs;         /* libs is only LOWER BOUND for the number of real liberties!!!	
 			       * It denotes only number of items in lib[], thus you can rely
 			       * on it to store real liberties only up to <= GROUP_REFILL_LIBS. */
-	coord_t lib[GROUP_KEEP_LIBS];  
+	coord_map_t lib[GROUP_KEEP_LIBS];
+#ifdef BOARD_LIBSET
+#define LIBSET_WORDS ((BOARD_MAX_COORDS + 63) / 64)
+	uint64_t libset[LIBSET_WORDS];  /* Exact set of liberties, bit per coord. Maintained
+					 * along with lib[] which stays as is. */
+#endif
 } group_info_t;
 
 
@@ -163,30 +173,9 @@ typedef struct board {
 FB_ONLY(bool superko_violation);  /* Whether we tried to add a hash twice; board_play*() can
 				   * set this, but it will still carry out the move as well! */
 
-	/* The following structures are goban maps and are indexed by coord. The map 
-	 * is surrounded by a one-point margin from S_OFFBOARD stones in order to
-	 * speed up some internal loops. Some of the foreach iterators below might
-	 * include these points; you need to handle them yourselves, if you need to. */	
-	
-	enum stone b[BOARD_MAX_COORDS];    /* Stones played on the board */
-	neighbors_t n[BOARD_MAX_COORDS];   /* Neighboring colors; numbers of neighbors of index color */
-	
-	group_t g[BOARD_MAX_COORDS];       /* Group id the stones are part of; 0 == no group */	
-	group_info_t gi[BOARD_MAX_COORDS]; /* Group information - indexed by gid (which is coord of base group stone) */
-	coord_t p[BOARD_MAX_COORDS];       /* Positions of next stones in the stone group; 0 == last stone */
-
-#ifdef BOARD_PAT3       
-FB_ONLY(hash3_t pat3)[BOARD_MAX_COORDS];   /* 3x3 pattern hash for each position; see pattern3.h for encoding
-					    * specification. The information is only valid for empty points. */
-#endif
-
-FB_ONLY(coord_t f)[BOARD_MAX_COORDS];      /* List of free positions - free position here is any valid move */
-FB_ONLY(int flen);                         /* including single-point eyes! */
-FB_ONLY(int fmap)[BOARD_MAX_COORDS];       /* Map free positions coords to their list index, for quick lookup. */
-
-#ifdef WANT_BOARD_C	
-FB_ONLY(group_t c)[BOARD_MAX_GROUPS];      /* List of capturable groups */
-FB_ONLY(int clen);
+FB_ONLY(int flen);                 /* Length of free positions list f[] */
+#ifdef WANT_BOARD_C
+FB_ONLY(int clen);                 /* Length of capturable groups list c[] */
 #endif
 
 FB_ONLY(bool playout_board);
@@ -203,10 +192,6 @@ FB_ONLY(hash_t hash_history)[BOARD_HASH_HISTORY]; /* Last hashes encountered, fo
 
 /*************************************************************************************************************/
 
-#ifdef DCNN_DARKFOREST
-FB_ONLY(int moveno)[BOARD_MAX_COORDS];     /* Move number for each coord */
-#endif
-
 #ifdef BOARD_UNDO_CHECKS	
 	int quicked;                       /* Guard against invalid quick_play() / quick_undo() uses */
 #endif
@@ -221,6 +206,39 @@ FB_ONLY(int moveno)[BOARD_MAX_COORDS];     /* Move number for each coord */
 	
 	void *ps;                          /* Playout-specific state; persistent through board development,
 					    * initialized by play_random_game() and free()'d at board destroy time */
+
+/*************************************************************************************************************/
+/* Goban maps, keep them last: board_copy() only copies the part in use
+ * for current board size (the first board_max_coords() entries). */
+
+	/* The following structures are goban maps and are indexed by coord. The map 
+	 * is surrounded by a one-point margin from S_OFFBOARD stones in order to
+	 * speed up some internal loops. Some of the foreach iterators below might
+	 * include these points; you need to handle them yourselves, if you need to. */	
+	
+	stone_map_t b[BOARD_MAX_COORDS];   /* Stones played on the board (enum stone) */
+	neighbors_t n[BOARD_MAX_COORDS];   /* Neighboring colors; numbers of neighbors of index color */
+	
+	coord_map_t g[BOARD_MAX_COORDS];   /* Group id the stones are part of; 0 == no group */	
+	coord_map_t p[BOARD_MAX_COORDS];   /* Positions of next stones in the stone group; 0 == last stone */
+	group_info_t gi[BOARD_MAX_COORDS]; /* Group information - indexed by gid (which is coord of base group stone) */
+
+#ifdef BOARD_PAT3       
+FB_ONLY(hash3_t pat3)[BOARD_MAX_COORDS];   /* 3x3 pattern hash for each position; see pattern3.h for encoding
+					    * specification. The information is only valid for empty points. */
+#endif
+
+FB_ONLY(coord_map_t f)[BOARD_MAX_COORDS];  /* List of free positions - free position here is any valid move */
+					   /* including single-point eyes! */
+FB_ONLY(coord_map_t fmap)[BOARD_MAX_COORDS]; /* Map free positions coords to their list index, for quick lookup. */
+
+#ifdef WANT_BOARD_C	
+FB_ONLY(coord_map_t c)[BOARD_MAX_GROUPS];  /* List of capturable groups */
+#endif
+
+#ifdef DCNN_DARKFOREST
+FB_ONLY(int moveno)[BOARD_MAX_COORDS];     /* Move number for each coord */
+#endif
 } board_t;
 
 
@@ -344,6 +362,10 @@ void board_symmetry_update(board_t *b, board_symmetry_t *symmetry, coord_t c);
 bool board_coord_in_symmetry(board_t *b, coord_t c);
 #endif
 
+/* Exact number of liberties of group @g (libs in group info is only exact
+ * up to GROUP_REFILL_LIBS). Popcount of the liberty set with BOARD_LIBSET,
+ * otherwise scans the group if it could have more. */
+int board_group_libs_exact(board_t *b, group_t g);
 /* Returns true if given coordinate has all neighbors of given color or the edge. */
 static bool board_is_eyelike(board_t *b, coord_t coord, enum stone eye_color);
 /* Returns true if given coordinate could be a false eye; this check makes
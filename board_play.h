@@ -1,5 +1,13 @@
 /* board_play() implementation */
 
+#ifdef BOARD_LIBSET
+#define libset_add(gi, c)  ((gi)->libset[(c) >> 6] |= 1ULL << ((c) & 63))
+#define libset_rm(gi, c)   ((gi)->libset[(c) >> 6] &= ~(1ULL << ((c) & 63)))
+#else
+#define libset_add(gi, c)  ((void)0)
+#define libset_rm(gi, c)   ((void)0)
+#endif
+
 static void
 board_group_addlib(board_t *board, group_t group, coord_t coord)
 {
@@ -9,6 +17,7 @@ board_group_addlib(board_t *board, group_t group, coord_t coord)
 			board_group_info(board, group).libs, coord2sstr(coord));
 
 	group_info_t *gi = &board_group_info(board, group);
+	libset_add(gi, coord);
 	if (gi->libs < GROUP_KEEP_LIBS) {
 		for (int i = 0; i < GROUP_KEEP_LIBS; i++) {
 #if 0                   /* Seems extra branch just slows it down */
@@ -62,6 +71,7 @@ board_group_rmlib(board_t *board, group_t group, coord_t coord)
 			board_group_info(board, group).libs, coord2sstr(coord));
 
 	group_info_t *gi = &board_group_info(board, group);
+	libset_rm(gi, coord);
 	for (int i = 0; i < GROUP_KEEP_LIBS; i++) {
 #if 0           /* Seems extra branch just slows it down */
 		if (!gi->lib[i]) break;
@@ -176,6 +186,11 @@ merge_groups(board_t *board, group_t group_to, group_t group_from)
 
 	if (DEBUGL(7))  fprintf(stderr,"---- (froml %d, tol %d)\n", gi_from->libs, gi_to->libs);
 
+#ifdef BOARD_LIBSET
+	for (int i = 0; i < LIBSET_WORDS; i++)
+		gi_to->libset[i] |= gi_from->libset[i];
+#endif
+
 	if (gi_to->libs < GROUP_KEEP_LIBS) {
 		for (int i = 0; i < gi_from->libs; i++) {
 			for (int j = 0; j < gi_to->libs; j++)
@@ -219,12 +234,14 @@ new_group(board_t *board, coord_t coord)
 	group_t group = coord;
 	group_info_t *gi = &board_group_info(board, group);
 	foreach_neighbor(board, coord, {
-		if (board_at(board, c) == S_NONE)
+		if (board_at(board, c) == S_NONE) {
+			libset_add(gi, c);
 			/* board_group_addlib is ridiculously expensive for us */
 #if GROUP_KEEP_LIBS < 4
 			if (gi->libs < GROUP_KEEP_LIBS)
 #endif
 			gi->lib[gi->libs++] = c;
+		}
 	});
 
 	group_at(board, coord) = group;
@@ -0,0 +1,46 @@
+#ifndef PACHI_BOARD_SPEC_H
+#define PACHI_BOARD_SPEC_H
+
+/* Board size specializations.
+ *
+ * Hot board code (board_play.c, board_undo.c) is compiled once for any
+ * board size and once for each of 9x9, 13x13 and 19x19 with BOARD_SIZE
+ * defined (see Makefile), so stride, neighbor offsets, map sizes etc
+ * become constants there. Matching implementation is picked whenever
+ * board size changes, board_play() and friends dispatch through it.
+ * Nothing to pick if Pachi is built for a fixed BOARD_SIZE already. */
+
+#include "board.h"
+#include "board_undo.h"
+
+/* Name of the variant being compiled. */
+#ifdef BOARD_SPEC
+#define board_spec__(name, size)  name ## _ ## size
+#define board_spec_(name, size)   board_spec__(name, size)
+#define board_spec(name)          board_spec_(name, BOARD_SIZE)
+#else
+#define board_spec(name)          name ## _generic
+#endif
+
+typedef struct {
+	int  (*play)(board_t *b, move_t *m);
+	void (*play_random)(board_t *b, enum stone color, coord_t *coord, ppr_permit permit, void *permit_data);
+	int  (*quick_play)(board_t *b, move_t *m, board_undo_t *u);
+	void (*quick_undo)(board_t *b, move_t *m, board_undo_t *u);
+} board_impl_t;
+
+#define board_impl_decl(suffix) \
+	int  board_play_ ## suffix(board_t *b, move_t *m); \
+	void board_play_random_ ## suffix(board_t *b, enum stone color, coord_t *coord, ppr_permit permit, void *permit_data); \
+	int  board_quick_play_ ## suffix(board_t *b, move_t *m, board_undo_t *u); \
+	void board_quick_undo_ ## suffix(board_t *b, move_t *m, board_undo_t *u)
+
+#define board_impl_init(suffix) \
+	{ board_play_ ## suffix, board_play_random_ ## suffix, board_quick_play_ ## suffix, board_quick_undo_ ## suffix }
+
+board_impl_decl(generic);
+board_impl_decl(9);
+board_impl_decl(13);
+board_impl_decl(19);
+
+#endif /* PACHI_BOARD_SPEC_H */
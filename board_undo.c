@@ -2,6 +2,7 @@
 #include "board.h"
 #include "debug.h"
 #include "board_undo.h"
+#include "board_spec.h"
 
 #if 0
 #define profiling_noinline __attribute__((noinline))
@@ -111,7 +112,7 @@ board_commit_move(board_t *b, move_t *m)
 #include "board_play.h"
 
 int
-board_quick_play(board_t *b, move_t *m, board_undo_t *u)
+board_spec(board_quick_play)(board_t *b, move_t *m, board_undo_t *u)
 {
 	assert(!is_resign(m->coord));  // XXX remove
 	
@@ -308,7 +309,7 @@ board_undo_suicide(board_t *b, board_undo_t *u, move_t *m)
 }
 
 void
-board_quick_undo(board_t *b, move_t *m, board_undo_t *u)
+board_spec(board_quick_undo)(board_t *b, move_t *m, board_undo_t *u)
 {
 #ifdef BOARD_UNDO_CHECKS
 	b->quicked--;
@@ -7,6 +7,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #define CPU_ONLY 1
 #include <caffe/caffe.hpp>
@@ -18,6 +19,7 @@ extern "C" {
 
 static shared_ptr<Net<float> > net;
 static int net_size = 0;		/* board size */
+static pthread_mutex_t net_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static int
 shape_size(const vector<int>& shape)
@@ -93,24 +95,41 @@ caffe_done()
 	net_size = 0;
 }
 	
+/* Evaluate n positions in one forward pass. data holds n consecutive
+ * inputs of planes * psize * psize, result gets n consecutive
+ * size * size outputs. Net is shared, forward passes are serialized. */
 void
-caffe_get_data(float *data, float *result, int size, int planes, int psize)
+caffe_get_data_batch(float *data, float *result, int n, int size, int planes, int psize)
 {
 	assert(net && net_size == size);
-	Blob<float> *blob = new Blob<float>(1, planes, psize, psize);
-	blob->set_cpu_data(data);
-	vector<Blob<float>*> bottom;
-	bottom.push_back(blob);
-	const vector<Blob<float>*>& rr = net->Forward(bottom);
-	assert(shape_size(rr[0]->shape()) >= size * size);
-	
-	for (int i = 0; i < size * size; i++) {
-		result[i] = rr[0]->cpu_data()[i];
-		if (result[i] < 0.00001)
-			result[i] = 0.00001;
+	pthread_mutex_lock(&net_mutex);
+
+	Blob<float> *input = net->input_blobs()[0];
+	if (input->shape(0) != n || input->shape(1) != planes) {
+		input->Reshape(n, planes, psize, psize);
+		net->Reshape();   /* Forward the dimension change. */
 	}
+	memcpy(input->mutable_cpu_data(), data, n * planes * psize * psize * sizeof(float));
+	const vector<Blob<float>*>& rr = net->Forward();
+	int stride = shape_size(rr[0]->shape()) / n;
+	assert(stride >= size * size);
 	
-	delete blob;
+	for (int k = 0; k < n; k++) {
+		for (int i = 0; i < size * size; i++) {
+			float *r = &result[k * size * size + i];
+			*r = rr[0]->cpu_data()[k * stride + i];
+			if (*r < 0.00001)
+				*r = 0.00001;
+		}
+	}
+
+	pthread_mutex_unlock(&net_mutex);
+}
+
+void
+caffe_get_data(float *data, float *result, int size, int planes, int psize)
+{
+	caffe_get_data_batch(data, result, 1, size, planes, psize);
 }
 
 	
@@ -11,8 +11,9 @@ bool caffe_ready(void);
 void caffe_init(int size, char *model, char *weights, char *name, int default_size);
 void caffe_done(void);
 void caffe_get_data(float *data, float *result, int size, int planes, int psize);
+void caffe_get_data_batch(float *data, float *result, int n, int size, int planes, int psize);
 
-#ifdef DCNN
+#ifdef DCNN_CAFFE
 void quiet_caffe(int argc, char *argv[]);
 #else
 #define quiet_caffe(argc, argv) ((void)0)
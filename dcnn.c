@@ -1,5 +1,6 @@
 #define DEBUG
 #include <assert.h>
+#include <pthread.h>
 #include <unistd.h>
 
 #include "debug.h"
@@ -7,10 +8,12 @@
 #include "engine.h"
 #include "uct/tree.h"
 #include "caffe.h"
+#include "dcnn_cpu.h"
 #include "dcnn.h"
 #include "timeinfo.h"
 
-typedef void (*dcnn_evaluate_t)(board_t *b, enum stone color, float result[]);
+/* Fill dcnn input planes for position, data is [planes][size][size] */
+typedef void (*dcnn_planes_t)(board_t *b, enum stone color, float *data);
 typedef bool (*dcnn_supported_board_size_t)(board_t *b);
 
 typedef struct {
@@ -20,7 +23,8 @@ typedef struct {
 	char *weights_filename;
 	int  default_size;
 	dcnn_supported_board_size_t supported_board_size;
-	dcnn_evaluate_t             eval;
+	int                         planes;
+	dcnn_planes_t               get_planes;
 	int  *global_var;
 } dcnn_t;
 
@@ -31,32 +35,66 @@ static bool board_15x15(board_t *b)        {  return (board_rsize(b) == 15);  }
 static bool board_13x13_and_up(board_t *b) {  return (board_rsize(b) >= 13);  }
 
 #ifdef DCNN_DETLEF
-static void detlef54_dcnn_eval(board_t *b, enum stone color, float result[]);
-static void detlef44_dcnn_eval(board_t *b, enum stone color, float result[]);
+static void detlef54_dcnn_planes(board_t *b, enum stone color, float *data);
+static void detlef44_dcnn_planes(board_t *b, enum stone color, float *data);
 #endif
 #ifdef DCNN_DARKFOREST
-static void darkforest_dcnn_eval(board_t *b, enum stone color, float result[]);
+static void darkforest_dcnn_planes(board_t *b, enum stone color, float *data);
 #endif
+static void dcnn_planes_init(board_t *b);
+static void dcnn_cache_init(board_t *b);
 
 int darkforest_dcnn = 0;
 
 static dcnn_t dcnns[] = {
 #ifdef DCNN_DETLEF
-{  "detlef",     "Detlef's 54%", "detlef54.prototxt",  "detlef54.trained", 19, board_13x13_and_up,   detlef54_dcnn_eval },
-{  "detlef54",   "Detlef's 54%", "detlef54.prototxt",  "detlef54.trained", 19, board_13x13_and_up,   detlef54_dcnn_eval },
-{  "detlef44",   "Detlef's 44%", "detlef44.prototxt",  "detlef44.trained", 19, board_19x19,          detlef44_dcnn_eval },
+{  "detlef",     "Detlef's 54%", "detlef54.prototxt",  "detlef54.trained", 19, board_13x13_and_up,   13, detlef54_dcnn_planes },
+{  "detlef54",   "Detlef's 54%", "detlef54.prototxt",  "detlef54.trained", 19, board_13x13_and_up,   13, detlef54_dcnn_planes },
+{  "detlef44",   "Detlef's 44%", "detlef44.prototxt",  "detlef44.trained", 19, board_19x19,          2,  detlef44_dcnn_planes },
 #endif
 #ifdef DCNN_DARKFOREST
-{  "df",         "Darkforest",   "df2.prototxt",       "df2.trained",      19, board_19x19,          darkforest_dcnn_eval,  &darkforest_dcnn },
-{  "darkforest", "Darkforest",   "df2.prototxt",       "df2.trained",      19, board_19x19,          darkforest_dcnn_eval,  &darkforest_dcnn },
-{  "df",         "Darkforest",   "df2_15x15.prototxt", "df2.trained",      15, board_15x15,          darkforest_dcnn_eval,  &darkforest_dcnn },
-{  "darkforest", "Darkforest",   "df2_15x15.prototxt", "df2.trained",      15, board_15x15,          darkforest_dcnn_eval,  &darkforest_dcnn },
+{  "df",         "Darkforest",   "df2.prototxt",       "df2.trained",      19, board_19x19,          25, darkforest_dcnn_planes,  &darkforest_dcnn },
+{  "darkforest", "Darkforest",   "df2.prototxt",       "df2.trained",      19, board_19x19,          25, darkforest_dcnn_planes,  &darkforest_dcnn },
+{  "df",         "Darkforest",   "df2_15x15.prototxt", "df2.trained",      15, board_15x15,          25, darkforest_dcnn_planes,  &darkforest_dcnn },
+{  "darkforest", "Darkforest",   "df2_15x15.prototxt", "df2.trained",      15, board_15x15,          25, darkforest_dcnn_planes,  &darkforest_dcnn },
 #endif
 {  0, }
 };
 
 static dcnn_t *dcnn = NULL;
 
+
+/* Inference backends, first one is the default. */
+typedef struct {
+	char *name;
+	bool (*ready)(void);
+	void (*init)(int size, char *model, char *weights, char *name, int default_size);
+	void (*done)(void);
+	void (*get_data_batch)(float *data, float *result, int n, int size, int planes, int psize);
+} dcnn_backend_t;
+
+static dcnn_backend_t backends[] = {
+#ifdef DCNN_CAFFE
+{  "caffe",  caffe_ready,    caffe_init,    caffe_done,    caffe_get_data_batch    },
+#endif
+{  "cpu",    cpu_net_ready,  cpu_net_init,  cpu_net_done,  cpu_net_get_data_batch  },
+{  0, }
+};
+
+static dcnn_backend_t *backend = &backends[0];
+
+void
+set_dcnn_backend(char *name)
+{
+	for (int i = 0; backends[i].name; i++)
+		if (!strcmp(name, backends[i].name)) {
+			backend = &backends[i];
+			return;
+		}
+
+	die("Unknown dcnn backend '%s'\n", name);
+}
+
 #define dcnn_supported_board_size(b) (dcnn->supported_board_size(b))
 
 /* Find dcnn entry for @name (can also be model/weights filename). */
@@ -82,6 +120,10 @@ list_dcnns()
 	printf("Supported networks:\n");
 	for (int i = 0; dcnns[i].name; i++)
 		printf("  %-20s %s dcnn\n", dcnns[i].name, dcnns[i].full_name);
+
+	printf("\nBackends:\n");
+	for (int i = 0; backends[i].name; i++)
+		printf("  %s%s\n", backends[i].name, (i ? "" : " (default)"));
 }
 
 static int
@@ -108,7 +150,7 @@ void require_dcnn(void)  {  dcnn_required = true;  }
 bool
 using_dcnn(board_t *b)
 {
-	bool r = dcnn_enabled && dcnn_supported_board_size(b) && caffe_ready();
+	bool r = dcnn_enabled && dcnn_supported_board_size(b) && backend->ready();
 	if (dcnn_required && !r)  die("dcnn required but not used, aborting.\n");
 	return r;
 }
@@ -118,24 +160,113 @@ dcnn_init(board_t *b)
 {
 	if (!dcnn)  dcnn = &dcnns[0];
 	if (dcnn_enabled && !dcnn_supported_board_size(b) && find_dcnn_for_board(b))
-		caffe_done();  /* Reload net */	
-	if (dcnn_enabled && dcnn_supported_board_size(b))
-		caffe_init(board_rsize(b), dcnn->model_filename, dcnn->weights_filename, dcnn->full_name, dcnn->default_size);
-	if (dcnn_required && !caffe_ready())  die("dcnn required, aborting.\n");
+		backend->done();  /* Reload net */	
+	if (dcnn_enabled && dcnn_supported_board_size(b)) {
+		backend->init(board_rsize(b), dcnn->model_filename, dcnn->weights_filename, dcnn->full_name, dcnn->default_size);
+		dcnn_planes_init(b);
+		dcnn_cache_init(b);
+	}
+	if (dcnn_required && !backend->ready())  die("dcnn required, aborting.\n");
+}
+
+int
+dcnn_input_size(board_t *b)
+{
+	int size = board_rsize(b);
+	return dcnn->planes * size * size;
+}
+
+void
+dcnn_get_planes(board_t *b, enum stone color, float *data)
+{
+	assert(dcnn_supported_board_size(b));
+	dcnn->get_planes(b, color, data);
+}
+
+void
+dcnn_evaluate_batch(board_t *b, float *data, float result[], int n)
+{
+	int size = board_rsize(b);
+	backend->get_data_batch(data, result, n, size, dcnn->planes, size);
 }
 
 void
 dcnn_evaluate_quiet(board_t *b, enum stone color, float result[])
 {
-	dcnn->eval(b, color, result);
+	dcnn_key_t key;
+	dcnn_cache_key(b, color, &key);
+	if (dcnn_cache_get(&key, result))
+		return;
+
+	float data[dcnn_input_size(b)];
+	dcnn_get_planes(b, color, data);
+	dcnn_evaluate_batch(b, data, result, 1);
+	dcnn_cache_put(&key, result);
 }
 
 void
 dcnn_evaluate(board_t *b, enum stone color, float result[])
 {
 	double time_start = time_now();	
-	dcnn->eval(b, color, result);
-	if (DEBUGL(2))  fprintf(stderr, "dcnn in %.2fs\n", time_now() - time_start);	
+	dcnn_evaluate_quiet(b, color, result);
+	if (DEBUGL(2)) {
+		int hits, lookups;
+		dcnn_cache_stats(&hits, &lookups);
+		fprintf(stderr, "dcnn in %.2fs (cache: %d / %d hits)\n", time_now() - time_start, hits, lookups);
+	}
+}
+
+
+/********************************************************************************************************/
+/* Input planes */
+
+/* Planes are filled in dcnn order (row by row) straight from the board
+ * arrays. Per board size tables are set up once by dcnn_planes_init():
+ * dcnn index -> coord and the darkforest constant planes, so building
+ * planes for a position doesn't recompute anything that only depends on
+ * board size. Can be called by multiple threads in parallel. */
+
+static int     planes_size = 0;
+static coord_t planes_coord[BOARD_MAX_MOVES];
+
+#ifdef DCNN_DARKFOREST
+/* Constant planes: border, position mask, rank */
+static float   df_border[BOARD_MAX_MOVES];
+static float   df_mask[BOARD_MAX_MOVES];
+static float   df_rank[BOARD_MAX_MOVES];
+
+/* History decay exp(-0.1 * d), d moves ago. Underflows to 0 beyond. */
+#define DF_DECAY_MAX 1100
+static float   df_decay[DF_DECAY_MAX];
+
+#define df_history_decay(d)  ((d) < DF_DECAY_MAX ? df_decay[d] : 0.0f)
+#endif
+
+static void
+dcnn_planes_init(board_t *b)
+{
+	int size = board_rsize(b);
+	if (planes_size == size)
+		return;
+
+	for (int y = 0; y < size; y++)
+	for (int x = 0; x < size; x++)
+		planes_coord[y * size + x] = coord_xy(x+1, y+1);
+
+#ifdef DCNN_DARKFOREST
+	float m = (float)(size+1) / 2;
+	for (int y = 0; y < size; y++)
+	for (int x = 0; x < size; x++) {
+		int p = y * size + x;
+		df_border[p] = (!x || !y || x == size-1 || y == size-1);
+		df_mask[p] = expf(-0.5 * ((x-m)*(x-m) + (y-m)*(y-m)));
+		df_rank[p] = 1.0;
+	}
+	for (int d = 0; d < DF_DECAY_MAX; d++)
+		df_decay[d] = exp(-0.1 * d);
+#endif
+
+	planes_size = size;
 }
 
 
@@ -148,33 +279,33 @@ dcnn_evaluate(board_t *b, enum stone color, float result[])
  * http://physik.de/CNNlast.tar.gz */
 
 static void
-detlef54_dcnn_eval(board_t *b, enum stone color, float result[])
+detlef54_dcnn_planes(board_t *b, enum stone color, float *data)
 {
-	assert(dcnn_supported_board_size(b));
-
 	int size = board_rsize(b);
-	float data[13][size][size];
-	memset(data, 0, sizeof(data));
+	int n = size * size;
+	assert(planes_size == size);
+	memset(data, 0, 13 * n * sizeof(float));
+
+	enum stone other_color = stone_other(color);
+	coord_t last1 = last_move(b).coord,  last2 = last_move2(b).coord;
+	coord_t last3 = last_move3(b).coord, last4 = last_move4(b).coord;
+	for (int p = 0; p < n; p++) {
+		coord_t c = planes_coord[p];
+		if (c == last1)		     data[9 * n + p] = 1.0;
+		else if (c == last2)	     data[10 * n + p] = 1.0;
+		else if (c == last3)	     data[11 * n + p] = 1.0;
+		else if (c == last4)	     data[12 * n + p] = 1.0;
 
-	for (int x = 0; x < size; x++)
-	for (int y = 0; y < size; y++) {
-		coord_t c = coord_xy(x+1, y+1);
-		group_t g = group_at(b, c);
 		enum stone bc = board_at(b, c);
-		int libs = board_group_info(b, g).libs - 1;
+		if (bc == S_NONE) {
+			data[8 * n + p] = 1.0;
+			continue;
+		}
+		int libs = board_group_info(b, group_at(b, c)).libs - 1;
 		if (libs > 3) libs = 3;
-		
-		if (bc == S_NONE)                    data[8][y][x] = 1.0;
-		else if (bc == color)                data[0+libs][y][x] = 1.0;
-		else if (bc == stone_other(color))   data[4+libs][y][x] = 1.0;
-		
-		if (c == last_move(b).coord)	     data[9][y][x] = 1.0;
-		else if (c == last_move2(b).coord)   data[10][y][x] = 1.0;
-		else if (c == last_move3(b).coord)   data[11][y][x] = 1.0;
-		else if (c == last_move4(b).coord)   data[12][y][x] = 1.0;
+		if (bc == color)             data[(0+libs) * n + p] = 1.0;
+		else if (bc == other_color)  data[(4+libs) * n + p] = 1.0;
 	}
-
-	caffe_get_data((float*)data, result, size, 13, size);
 }
 
 
@@ -186,22 +317,18 @@ detlef54_dcnn_eval(board_t *b, enum stone color, float result[])
  * http://physik.de/net.tgz */
 
 static void
-detlef44_dcnn_eval(board_t *b, enum stone color, float result[])
+detlef44_dcnn_planes(board_t *b, enum stone color, float *data)
 {
-	enum stone other_color = stone_other(color);
-
 	int size = board_rsize(b);
-	float data[2][size][size];
-	memset(data, 0, sizeof(data));
+	int n = size * size;
+	assert(planes_size == size);
+	enum stone other_color = stone_other(color);
 
-	for (int y = 0; y < size; y++)
-	for (int x = 0; x < size; x++) {
-                coord_t c = coord_xy(x+1, y+1);
-		if (board_at(b, c) == color)        data[0][y][x] = 1;
-		if (board_at(b, c) == other_color)  data[1][y][x] = 1;			
+	for (int p = 0; p < n; p++) {
+		enum stone bc = board_at(b, planes_coord[p]);
+		data[p]     = (bc == color);
+		data[n + p] = (bc == other_color);
 	}
-
-	caffe_get_data((float*)data, result, size, 2, size);
 }
 #endif /* DCNN_DETLEF */
 
@@ -214,121 +341,316 @@ detlef44_dcnn_eval(board_t *b, enum stone color, float result[])
  * https://github.com/facebookresearch/darkforestGo
  * https://arxiv.org/abs/1511.06410 */
 
+/* Manhattan distance to closest stone of each color, both maps at once. */
 static void
-df_distance_transform(float *arr, int size)
+df_distance_transform(int *our, int *opp, int size)
 {
 	// First dimension.
+	for (int i = 1; i < size; i++)
+	for (int j = 0; j < size; j++) {
+		int p = i*size + j, q = (i-1)*size + j;
+		our[p] = MIN(our[p], our[q] + 1);
+		opp[p] = MIN(opp[p], opp[q] + 1);
+	}
+	for (int i = size - 2; i >= 0; i--)
 	for (int j = 0; j < size; j++) {
-		for (int i = 1; i < size; i++) 
-			arr[i*size + j] = MIN(arr[i*size + j], arr[(i-1)*size + j] + 1);
-		for (int i = size - 2; i >= 0; i--) 
-			arr[i*size + j] = MIN(arr[i*size + j], arr[(i+1)*size + j] + 1);
+		int p = i*size + j, q = (i+1)*size + j;
+		our[p] = MIN(our[p], our[q] + 1);
+		opp[p] = MIN(opp[p], opp[q] + 1);
 	}
 	// Second dimension
 	for (int i = 0; i < size; i++) {
-		for (int j = 1; j < size; j++)
-			arr[i*size + j] = MIN(arr[i*size + j], arr[i*size + (j-1)] + 1);
-		for (int j = size - 2; j >= 0; j--) 
-			arr[i*size + j] = MIN(arr[i*size+j], arr[i * size + (j+1)] + 1);
+		for (int j = 1; j < size; j++) {
+			int p = i*size + j;
+			our[p] = MIN(our[p], our[p-1] + 1);
+			opp[p] = MIN(opp[p], opp[p-1] + 1);
+		}
+		for (int j = size - 2; j >= 0; j--) {
+			int p = i*size + j;
+			our[p] = MIN(our[p], our[p+1] + 1);
+			opp[p] = MIN(opp[p], opp[p+1] + 1);
+		}
 	}
 }
 
 static void
-df_get_distance_map(board_t *b, enum stone color, float *data) 
+darkforest_dcnn_planes(board_t *b, enum stone color, float *data)
 {
+	enum stone other_color = stone_other(color);
 	int size = board_rsize(b);
-	for (int i = 0; i < size; i++) {
-		for (int j = 0; j < size; j++) {
-			coord_t c = coord_xy(i+1, j+1);
-			if (board_at(b, c) == color)
-				data[i*size + j] = 0;
-			else
-				data[i*size + j] = 10000;
+	int n = size * size;
+	assert(planes_size == size);
+	memset(data, 0, 12 * n * sizeof(float));
+	memset(&data[14 * n], 0, 11 * n * sizeof(float));
+
+	int our_dist[n], opponent_dist[n];
+	float other_decay = df_history_decay(b->moves + 1);  /* moveno 0 */
+
+	for (int p = 0; p < n; p++) {
+		coord_t c = planes_coord[p];
+		enum stone bc = board_at(b, c);
+		our_dist[p]      = (bc == color ? 0 : 10000);
+		opponent_dist[p] = (bc == other_color ? 0 : 10000);
+
+		/* planes 10, 11: our / opponent history */
+		/* FIXME -1 for komi */
+		if (bc == S_NONE) {
+			data[10 * n + p] = data[11 * n + p] = df_history_decay(b->moves + 1 - b->moveno[c]);
+			/* plane 9: empty spots. */
+			data[9 * n + p] = 1;
+			continue;
+		}
+
+		int libs = board_group_info(b, group_at(b, c)).libs;
+		if (libs > 3) libs = 3;
+		float decay = df_history_decay(b->moves + 1 - b->moveno[c]);
+
+		if (bc == color) {
+			/* plane 0: our stones with 1 liberty */
+			/* plane 1: our stones with 2 liberties */
+			/* plane 2: our stones with 3+ liberties */
+			data[(libs-1) * n + p] = 1;
+			/* plane 6: our simple ko  (but actually, our stones. typo ?) */
+			data[6 * n + p] = 1;
+			/* plane 7: our stones. */
+			data[7 * n + p] = 1;
+			data[10 * n + p] = decay;
+			data[11 * n + p] = other_decay;
+		} else {
+			/* planes 3, 4, 5: opponent liberties */
+			data[(3+libs-1) * n + p] = 1;
+			/* plane 8: opponent stones. */
+			data[8 * n + p] = 1;
+			data[10 * n + p] = other_decay;
+			data[11 * n + p] = decay;
 		}
 	}
-	df_distance_transform(data, size);
+
+	/* plane 12: border */
+	memcpy(&data[12 * n], df_border, n * sizeof(float));
+	/* plane 13: position mask - distance from corner */
+	memcpy(&data[13 * n], df_mask, n * sizeof(float));
+
+	/* plane 14: closest color is ours */
+	/* plane 15: closest color is opponent */
+	/* These have always been read transposed, (x, y) from (y, x). */
+	df_distance_transform(our_dist, opponent_dist, size);
+	for (int y = 0; y < size; y++)
+	for (int x = 0; x < size; x++) {
+		int p = y * size + x, t = x * size + y;
+		data[14 * n + p] = (our_dist[t] < opponent_dist[t]);
+		data[15 * n + p] = (opponent_dist[t] < our_dist[t]);
+	}
+
+	/* planes 16-24: encode rank - set 9th plane for 9d */
+	memcpy(&data[24 * n], df_rank, n * sizeof(float));
 }
+#endif /* DCNN_DARKFOREST */
+
 
-static float
-df_board_history_decay(board_t *b, coord_t coord, enum stone color)
+/********************************************************************************************************/
+/* Evaluation cache */
+
+/* LRU cache of dcnn outputs, shared by all threads. Entries live in
+ * fixed arrays: hash chains for lookup, doubly linked list in use order
+ * (head is most recent) for eviction. Results are stored in canonical
+ * orientation, rot_idx[rot][p] is index of dcnn point p once rotated. */
+
+static int     cache_entries = 4096;
+static int     cache_size = 0;		/* board size cache is set up for */
+static dcnn_t *cache_dcnn = NULL;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int     rot_idx[8][BOARD_MAX_MOVES];
+static hash_t *cache_hash;
+static float  *cache_data;
+static int    *cache_prev, *cache_next, *cache_chain;
+static int    *cache_buckets;
+static int     cache_nbuckets;
+static int     cache_head, cache_tail, cache_used;
+static int     cache_hits, cache_lookups;
+
+void
+set_dcnn_cache(int entries)
 {
-	int v = 0;
-	if (board_at(b, coord) == color || board_at(b, coord) == S_NONE)
-		v = b->moveno[coord];
-	return exp(0.1 * (v - (b->moves+1)));
+	if (entries < 0)  die("invalid dcnn cache size: %i\n", entries);
+	cache_entries = entries;
 }
 
 static void
-darkforest_dcnn_eval(board_t *b, enum stone color, float result[])
+dcnn_cache_free(void)
 {
-	enum stone other_color = stone_other(color);
-	int size = board_rsize(b);
-	float data[25][size][size];
-	memset(data, 0, sizeof(data));
-	
-	float our_dist[size * size];
-	float opponent_dist[size * size];
-	df_get_distance_map(b, color, our_dist);
-	df_get_distance_map(b, other_color, opponent_dist);
-	
-	for (int y = 0; y < size; y++)
-	for (int x = 0; x < size; x++) {
-		int p = size * y + x;
-		coord_t c = coord_xy(x+1, y+1);
-		group_t g = group_at(b, c);
-		enum stone bc = board_at(b, c);
-		int libs = board_group_info(b, g).libs;
-		if (libs > 3) libs = 3;
-			
-		/* plane 0: our stones with 1 liberty */
-		/* plane 1: our stones with 2 liberties */
-		/* plane 2: our stones with 3+ liberties */
-		if (bc == color)              data[libs-1][y][x] = 1;
+	free(cache_hash);     cache_hash = NULL;
+	free(cache_data);     cache_data = NULL;
+	free(cache_prev);     cache_prev = NULL;
+	free(cache_next);     cache_next = NULL;
+	free(cache_chain);    cache_chain = NULL;
+	free(cache_buckets);  cache_buckets = NULL;
+}
 
-		/* planes 3, 4, 5: opponent liberties */
-		if (bc == other_color)        data[3+libs-1][y][x] = 1;
+/* Keep cache across games unless board size or network changed. */
+static void
+dcnn_cache_init(board_t *b)
+{
+	int size = board_rsize(b);
+	if ((cache_size == size && cache_dcnn == dcnn) || !cache_entries)
+		return;
+
+	for (int rot = 0; rot < 8; rot++)
+		for (int p = 0; p < size * size; p++)
+			rot_idx[rot][p] = coord2dcnn_idx(rotate_coord(planes_coord[p], rot));
+
+	dcnn_cache_free();
+	int n = cache_entries;
+	cache_nbuckets = 1;
+	while (cache_nbuckets < n)  cache_nbuckets *= 2;
+	cache_hash    = calloc2(n, hash_t);
+	cache_data    = cmalloc(n * size * size * sizeof(float));
+	cache_prev    = calloc2(n, int);
+	cache_next    = calloc2(n, int);
+	cache_chain   = calloc2(n, int);
+	cache_buckets = cmalloc(cache_nbuckets * sizeof(int));
+	memset(cache_buckets, -1, cache_nbuckets * sizeof(int));
+	cache_head = cache_tail = -1;
+	cache_used = cache_hits = cache_lookups = 0;
+	cache_size = size;
+	cache_dcnn = dcnn;
+}
 
-		/* plane 6: our simple ko  (but actually, our stones. typo ?) */
-		if (bc == color)              data[6][y][x] = 1;
+/* Inputs only see stones, liberties (derived from stones) and last
+ * moves, so hash these for each symmetry and keep the smallest.
+ * Darkforest's older history planes are ignored. */
+void
+dcnn_cache_key(board_t *b, enum stone color, dcnn_key_t *key)
+{
+	key->hash = 0;
+	key->rot = 0;
+	if (!cache_hash)
+		return;
+
+	int n = cache_size * cache_size;
+	hash_t h[8] = { 0, };
+	for (int p = 0; p < n; p++) {
+		enum stone bc = board_at(b, planes_coord[p]);
+		if (bc == S_NONE)
+			continue;
+		for (int rot = 0; rot < 8; rot++)
+			h[rot] ^= hash_at(planes_coord[rot_idx[rot][p]], bc);
+	}
 
-		/* plane 7: our stones. */
-		if (bc == color)              data[7][y][x] = 1;
+	coord_t last[4] = { last_move(b).coord,  last_move2(b).coord,
+			    last_move3(b).coord, last_move4(b).coord };
+	for (int k = 0; k < 4; k++) {
+		if (last[k] < 0 || board_at(b, last[k]) == S_OFFBOARD)
+			continue;
+		int p = coord2dcnn_idx(last[k]);
+		for (int rot = 0; rot < 8; rot++)
+			h[rot] ^= hash_at(planes_coord[rot_idx[rot][p]], S_BLACK) * (2 * k + 3);
+	}
 
-		/* plane 8: opponent stones. */
-		if (bc == other_color)        data[8][y][x] = 1;
+	for (int rot = 0; rot < 8; rot++) {
+		if (color == S_WHITE)  h[rot] = ~h[rot];
+		if (!rot || h[rot] < key->hash) {
+			key->hash = h[rot];
+			key->rot = rot;
+		}
+	}
+}
 
-		/* plane 9: empty spots. */
-		if (bc == S_NONE)             data[9][y][x] = 1;
+static int
+dcnn_cache_find(hash_t hash)
+{
+	for (int i = cache_buckets[hash & (cache_nbuckets - 1)]; i >= 0; i = cache_chain[i])
+		if (cache_hash[i] == hash)
+			return i;
+	return -1;
+}
 
-		/* plane 10: our history */
-		/* FIXME -1 for komi */
-		data[10][y][x] = df_board_history_decay(b, c, color);
-			
-		/* plane 11: opponent history */
-		/* FIXME -1 for komi */
-		data[11][y][x] = df_board_history_decay(b, c, other_color);
+static void
+dcnn_cache_unlink(int i)
+{
+	if (cache_prev[i] >= 0)  cache_next[cache_prev[i]] = cache_next[i];
+	else                     cache_head = cache_next[i];
+	if (cache_next[i] >= 0)  cache_prev[cache_next[i]] = cache_prev[i];
+	else                     cache_tail = cache_prev[i];
+}
 
-		/* plane 12: border */
-		if (!x || !y || x == size-1 || y == size-1)
-			data[12][y][x] = 1.0;
-		
-		/* plane 13: position mask - distance from corner */
-		float m = (float)(size+1) / 2;
-		data[13][y][x] = expf(-0.5 * ((x-m)*(x-m) + (y-m)*(y-m)));
+static void
+dcnn_cache_push_front(int i)
+{
+	cache_prev[i] = -1;
+	cache_next[i] = cache_head;
+	if (cache_head >= 0)  cache_prev[cache_head] = i;
+	cache_head = i;
+	if (cache_tail < 0)  cache_tail = i;
+}
 
-		/* plane 14: closest color is ours */
-		data[14][y][x] = (our_dist[p] < opponent_dist[p]);
+bool
+dcnn_cache_get(dcnn_key_t *key, float result[])
+{
+	if (!cache_hash)
+		return false;
+
+	int n = cache_size * cache_size;
+	pthread_mutex_lock(&cache_lock);
+	cache_lookups++;
+	int i = dcnn_cache_find(key->hash);
+	if (i >= 0) {
+		cache_hits++;
+		float *r = &cache_data[i * n];
+		for (int p = 0; p < n; p++)
+			result[p] = r[rot_idx[key->rot][p]];
+		dcnn_cache_unlink(i);
+		dcnn_cache_push_front(i);
+	}
+	pthread_mutex_unlock(&cache_lock);
+	return (i >= 0);
+}
 
-		/* plane 15: closest color is opponent */
-		data[15][y][x] = (opponent_dist[p] < our_dist[p]);
+void
+dcnn_cache_put(dcnn_key_t *key, float result[])
+{
+	if (!cache_hash)
+		return;
+
+	int n = cache_size * cache_size;
+	pthread_mutex_lock(&cache_lock);
+	if (dcnn_cache_find(key->hash) >= 0) {
+		pthread_mutex_unlock(&cache_lock);
+		return;
+	}
 
-		/* planes 16-24: encode rank - set 9th plane for 9d */
-		data[24][y][x] = 1.0;
+	int i;
+	if (cache_used < cache_entries)
+		i = cache_used++;
+	else {  /* Evict least recently used */
+		i = cache_tail;
+		dcnn_cache_unlink(i);
+		int *pi = &cache_buckets[cache_hash[i] & (cache_nbuckets - 1)];
+		while (*pi != i)  pi = &cache_chain[*pi];
+		*pi = cache_chain[i];
 	}
 
-	caffe_get_data((float*)data, result, size, 25, size);
+	cache_hash[i] = key->hash;
+	int *bucket = &cache_buckets[key->hash & (cache_nbuckets - 1)];
+	cache_chain[i] = *bucket;
+	*bucket = i;
+	dcnn_cache_push_front(i);
+
+	float *r = &cache_data[i * n];
+	for (int p = 0; p < n; p++)
+		r[rot_idx[key->rot][p]] = result[p];
+	pthread_mutex_unlock(&cache_lock);
+}
+
+void
+dcnn_cache_stats(int *hits, int *lookups)
+{
+	pthread_mutex_lock(&cache_lock);
+	*hits = cache_hits;
+	*lookups = cache_lookups;
+	pthread_mutex_unlock(&cache_lock);
 }
-#endif /* DCNN_DARKFOREST */
 
 
 /********************************************************************************************************/
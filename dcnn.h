@@ -8,6 +8,8 @@
 
 /* Choose which dcnn to load */
 void set_dcnn(char *name);
+/* Choose inference backend: caffe, cpu */
+void set_dcnn_backend(char *name);
 void list_dcnns(void);
 int dcnn_default_board_size(void);
 
@@ -17,8 +19,34 @@ void disable_dcnn(void);
 
 void dcnn_evaluate(board_t *b, enum stone color, float result[]);
 void dcnn_evaluate_quiet(board_t *b, enum stone color, float result[]);
+
+/* Batched evaluation: build input planes for each position separately
+ * (dcnn_input_size() floats each), then evaluate n consecutive inputs
+ * at once. result gets n consecutive size * size outputs. */
+int  dcnn_input_size(board_t *b);
+void dcnn_get_planes(board_t *b, enum stone color, float *data);
+void dcnn_evaluate_batch(board_t *b, float *data, float result[], int n);
 bool using_dcnn(board_t *b);
 void dcnn_init(board_t *b);
+
+/* Evaluation cache: LRU cache of dcnn outputs shared by all threads,
+ * kept across moves and games (reset if board size or network changes).
+ * Key is the position and side to move, canonicalized over the 8 board
+ * symmetries so mirrored / rotated positions hit as well.
+ * dcnn_evaluate() and dcnn_evaluate_quiet() go through it, batch users
+ * call it explicitly. */
+typedef struct {
+	hash_t hash;
+	int rot;	/* rotation to canonical orientation */
+} dcnn_key_t;
+
+/* Number of entries, 0 disables. Must be called before dcnn_init(). */
+void set_dcnn_cache(int entries);
+void dcnn_cache_key(board_t *b, enum stone color, dcnn_key_t *key);
+bool dcnn_cache_get(dcnn_key_t *key, float result[]);
+void dcnn_cache_put(dcnn_key_t *key, float result[]);
+void dcnn_cache_stats(int *hits, int *lookups);
+
 void get_dcnn_best_moves(board_t *b, float *r, coord_t *best_c, float *best_r, int nbest);
 void print_dcnn_best_moves(board_t *b, coord_t *best_c, float *best_r, int nbest);
 
@@ -42,6 +70,8 @@ coord2dcnn_idx(coord_t c)
 
 
 #define set_dcnn(n)     die("dcnn required but not compiled in, aborting.\n")
+#define set_dcnn_backend(n)  die("dcnn required but not compiled in, aborting.\n")
+#define set_dcnn_cache(n)    die("dcnn required but not compiled in, aborting.\n")
 #define dcnn_default_board_size()  19
 #define disable_dcnn()  ((void)0)
 #define require_dcnn()  die("dcnn required but not compiled in, aborting.\n")
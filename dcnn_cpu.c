@@ -0,0 +1,320 @@
+#define DEBUG
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "util.h"
+#include "dcnn_cpu.h"
+
+/* Builtin dcnn inference.
+ *
+ * File format (native endianness, as written by tools/dcnn2bin.py):
+ *   char    magic[8]   "PACHINN1"
+ *   int32   layers
+ *   then for each layer an int32 type followed by:
+ *     CONV:     int32 in, out, ksize, pad, relu
+ *               float weights[out][in][ksize][ksize], bias[out]
+ *     BIAS:     int32 channels, height, width
+ *               float bias[channels][height][width]
+ *     SOFTMAX:  nothing, softmax over the whole output of each position.
+ *
+ * Convolutions must preserve the board size (ksize = 2 * pad + 1), so the
+ * net can evaluate any board size unless it has position biases. Output
+ * is the first size * size values of the last layer, like caffe's.
+ *
+ * Loops are written over contiguous rows of the board so that they
+ * vectorize. Scratch buffers are allocated once for the widest layer,
+ * so evaluations are serialized. */
+
+#define CPU_NET_MAGIC "PACHINN1"
+
+enum cpu_layer_type {
+	CPU_LAYER_CONV = 1,
+	CPU_LAYER_BIAS = 2,
+	CPU_LAYER_SOFTMAX = 3,
+};
+
+typedef struct {
+	enum cpu_layer_type type;
+	int in, out, ksize, pad;	/* conv */
+	bool relu;
+	int height, width;		/* bias */
+	float *weights;
+	float *bias;
+} cpu_layer_t;
+
+typedef struct {
+	int nlayers;
+	cpu_layer_t *layers;
+	int input_planes;
+	int max_channels;		/* widest layer */
+	int max_pad;
+} cpu_net_t;
+
+static cpu_net_t *net = NULL;
+static int net_size = 0;		/* board size */
+static pthread_mutex_t net_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Scratch buffers for current board size: layer input / output
+ * and zero padded input. */
+static float *buf_a = NULL, *buf_b = NULL, *buf_pad = NULL;
+
+
+static int32_t
+read_int(FILE *f, char *filename)
+{
+	int32_t v;
+	if (fread(&v, sizeof(v), 1, f) != 1)
+		die("%s: truncated dcnn file\n", filename);
+	return v;
+}
+
+static float *
+read_floats(FILE *f, char *filename, size_t n)
+{
+	float *p = (float *)cmalloc(n * sizeof(float));
+	if (fread(p, sizeof(float), n, f) != n)
+		die("%s: truncated dcnn file\n", filename);
+	return p;
+}
+
+static cpu_net_t *
+cpu_net_load(char *filename)
+{
+	FILE *f = fopen(filename, "rb");
+	if (!f)  fail(filename);
+
+	char magic[8];
+	if (fread(magic, sizeof(magic), 1, f) != 1 || memcmp(magic, CPU_NET_MAGIC, sizeof(magic)))
+		die("%s: not a dcnn file, convert it with tools/dcnn2bin.py\n", filename);
+
+	cpu_net_t *n = calloc2(1, cpu_net_t);
+	n->nlayers = read_int(f, filename);
+	if (n->nlayers <= 0 || n->nlayers > 1000)
+		die("%s: bad number of layers\n", filename);
+	n->layers = calloc2(n->nlayers, cpu_layer_t);
+
+	int channels = 0;
+	for (int i = 0; i < n->nlayers; i++) {
+		cpu_layer_t *l = &n->layers[i];
+		l->type = (enum cpu_layer_type)read_int(f, filename);
+		switch (l->type) {
+			case CPU_LAYER_CONV:
+				l->in    = read_int(f, filename);
+				l->out   = read_int(f, filename);
+				l->ksize = read_int(f, filename);
+				l->pad   = read_int(f, filename);
+				l->relu  = read_int(f, filename);
+				if (l->in <= 0 || l->out <= 0 || l->ksize != 2 * l->pad + 1)
+					die("%s: layer %i: unsupported convolution\n", filename, i);
+				if (i && l->in != channels)
+					die("%s: layer %i: expected %i input channels, got %i\n", filename, i, channels, l->in);
+				if (!i)  n->input_planes = l->in;
+				l->weights = read_floats(f, filename, (size_t)l->out * l->in * l->ksize * l->ksize);
+				l->bias    = read_floats(f, filename, l->out);
+				channels = l->out;
+				if (l->in > n->max_channels)   n->max_channels = l->in;
+				if (l->out > n->max_channels)  n->max_channels = l->out;
+				if (l->pad > n->max_pad)       n->max_pad = l->pad;
+				break;
+			case CPU_LAYER_BIAS:
+				l->out    = read_int(f, filename);
+				l->height = read_int(f, filename);
+				l->width  = read_int(f, filename);
+				if (!i || l->out != channels)
+					die("%s: layer %i: bias doesn't match previous layer\n", filename, i);
+				l->bias = read_floats(f, filename, (size_t)l->out * l->height * l->width);
+				break;
+			case CPU_LAYER_SOFTMAX:
+				if (!i)  die("%s: layer %i: softmax can't be first\n", filename, i);
+				break;
+			default:
+				die("%s: layer %i: unknown layer type %i\n", filename, i, l->type);
+		}
+	}
+	fclose(f);
+	return n;
+}
+
+static void
+cpu_net_free(cpu_net_t *n)
+{
+	for (int i = 0; i < n->nlayers; i++) {
+		free(n->layers[i].weights);
+		free(n->layers[i].bias);
+	}
+	free(n->layers);
+	free(n);
+}
+
+bool
+cpu_net_ready(void)
+{
+	return (net != NULL);
+}
+
+void
+cpu_net_init(int size, char *model, char *weights, char *name, int default_size)
+{
+	if (net && net_size == size)  return;   /* Nothing to do. */
+
+	if (!net) {
+		/* detlef54.prototxt -> detlef54.bin */
+		char filename[256];
+		strncpy(filename, model, sizeof(filename) - 5);
+		filename[sizeof(filename) - 5] = 0;
+		char *ext = strrchr(filename, '.');
+		if (ext)  *ext = 0;
+		strcat(filename, ".bin");
+
+		char path[256];  get_data_file(path, filename);
+		if (!file_exists(path)) {
+			if (DEBUGL(1))  fprintf(stderr, "Loading dcnn file: %s\n"
+						        "Couldn't find dcnn file, aborting.\n", filename);
+#ifdef _WIN32
+			popup("ERROR: Couldn't find Pachi data files.\n");
+#endif
+			exit(1);
+		}
+		net = cpu_net_load(path);
+	}
+
+	/* Fully convolutional: only position biases depend on board size. */
+	for (int i = 0; i < net->nlayers; i++) {
+		cpu_layer_t *l = &net->layers[i];
+		if (l->type == CPU_LAYER_BIAS && (l->height != size || l->width != size))
+			die("%s dcnn only supports %ix%i board\n", name, l->width, l->height);
+	}
+	net_size = size;
+
+	int n = size * size;
+	int psz = size + 2 * net->max_pad;
+	free(buf_a);  free(buf_b);  free(buf_pad);
+	buf_a   = (float *)cmalloc(net->max_channels * n * sizeof(float));
+	buf_b   = (float *)cmalloc(net->max_channels * n * sizeof(float));
+	buf_pad = (float *)cmalloc(net->max_channels * psz * psz * sizeof(float));
+
+	if (DEBUGL(1))
+		fprintf(stderr, "Loaded %s dcnn for %ix%i (cpu)\n", name, size, size);
+}
+
+void
+cpu_net_done(void)
+{
+	if (net)  cpu_net_free(net);
+	net = NULL;
+	net_size = 0;
+	free(buf_a);  free(buf_b);  free(buf_pad);
+	buf_a = buf_b = buf_pad = NULL;
+}
+
+
+/* Same size convolution of in ([l->in][size][size]) into out.
+ * pbuf is scratch space for the zero padded input. */
+static void
+cpu_conv(cpu_layer_t *l, float *restrict in, float *restrict out, float *restrict pbuf, int size)
+{
+	int n = size * size;
+	int k = l->ksize, pad = l->pad;
+	int psize = size + 2 * pad;
+	int pn = psize * psize;
+
+	memset(pbuf, 0, l->in * pn * sizeof(float));
+	for (int c = 0; c < l->in; c++)
+	for (int y = 0; y < size; y++)
+		memcpy(&pbuf[c * pn + (y + pad) * psize + pad], &in[c * n + y * size], size * sizeof(float));
+
+	for (int o = 0; o < l->out; o++) {
+		float *restrict dst = &out[o * n];
+		float bias = l->bias[o];
+		for (int i = 0; i < n; i++)
+			dst[i] = bias;
+
+		for (int c = 0; c < l->in; c++) {
+			const float *w = &l->weights[(o * l->in + c) * k * k];
+			const float *src = &pbuf[c * pn];
+			for (int ky = 0; ky < k; ky++)
+			for (int kx = 0; kx < k; kx++) {
+				float wv = w[ky * k + kx];
+				for (int y = 0; y < size; y++) {
+					const float *restrict s = &src[(y + ky) * psize + kx];
+					float *restrict d = &dst[y * size];
+					for (int x = 0; x < size; x++)
+						d[x] += wv * s[x];
+				}
+			}
+		}
+
+		if (l->relu)
+			for (int i = 0; i < n; i++)
+				dst[i] = (dst[i] > 0 ? dst[i] : 0);
+	}
+}
+
+static void
+cpu_softmax(float *data, int n)
+{
+	float max = data[0];
+	for (int i = 1; i < n; i++)
+		if (data[i] > max)  max = data[i];
+	float sum = 0;
+	for (int i = 0; i < n; i++) {
+		data[i] = expf(data[i] - max);
+		sum += data[i];
+	}
+	for (int i = 0; i < n; i++)
+		data[i] /= sum;
+}
+
+/* Evaluate n positions. data holds n consecutive inputs of
+ * planes * psize * psize, result gets n consecutive size * size outputs.
+ * Scratch buffers are shared, evaluations are serialized. */
+void
+cpu_net_get_data_batch(float *data, float *result, int n, int size, int planes, int psize)
+{
+	assert(net && net_size == size && psize == size);
+	if (planes != net->input_planes)
+		die("dcnn: net expects %i input planes, got %i\n", net->input_planes, planes);
+
+	pthread_mutex_lock(&net_mutex);
+	int bn = size * size;
+	float *a = buf_a, *b = buf_b;
+
+	for (int k = 0; k < n; k++) {
+		memcpy(a, &data[k * planes * bn], planes * bn * sizeof(float));
+		int channels = planes;
+		for (int i = 0; i < net->nlayers; i++) {
+			cpu_layer_t *l = &net->layers[i];
+			switch (l->type) {
+				case CPU_LAYER_CONV: {
+					cpu_conv(l, a, b, buf_pad, size);
+					float *t = a;  a = b;  b = t;
+					channels = l->out;
+					break;
+				}
+				case CPU_LAYER_BIAS:
+					for (int j = 0; j < channels * bn; j++)
+						a[j] += l->bias[j];
+					break;
+				case CPU_LAYER_SOFTMAX:
+					cpu_softmax(a, channels * bn);
+					break;
+			}
+		}
+
+		for (int i = 0; i < bn; i++) {
+			float *r = &result[k * bn + i];
+			*r = a[i];
+			if (*r < 0.00001)
+				*r = 0.00001;
+		}
+	}
+
+	pthread_mutex_unlock(&net_mutex);
+}
@@ -0,0 +1,15 @@
+#ifndef PACHI_DCNN_CPU_H
+#define PACHI_DCNN_CPU_H
+
+/* Builtin dcnn backend: plain cpu inference, no external dependencies.
+ * Supports fully convolutional nets (conv + relu, per position bias,
+ * softmax) in the flat binary format written by tools/dcnn2bin.py.
+ * Weights are loaded from the model filename with a .bin extension,
+ * for example detlef54.prototxt -> detlef54.bin */
+
+bool cpu_net_ready(void);
+void cpu_net_init(int size, char *model, char *weights, char *name, int default_size);
+void cpu_net_done(void);
+void cpu_net_get_data_batch(float *data, float *result, int n, int size, int planes, int psize);
+
+#endif /* PACHI_DCNN_CPU_H */
@@ -4,7 +4,6 @@
 #include "debug.h"
 #include "board.h"
 #include "engine.h"
-#include "caffe.h"
 #include "../dcnn.h"
 #include "engines/dcnn.h"
 
@@ -45,7 +44,7 @@ void
 engine_dcnn_init(engine_t *e, char *arg, board_t *b)
 {
 	dcnn_init(b);
-	if (!caffe_ready()) {
+	if (!using_dcnn(b)) {
 		fprintf(stderr, "Couldn't initialize dcnn, aborting.\n");
 		abort();
 	}
@@ -0,0 +1,154 @@
+#define DEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
+#include "debug.h"
+#include "util.h"
+#include "numa.h"
+
+#define NUMA_MAX_CPUS 1024
+
+static int nodes = 1;
+static int ncpus = 0;
+static int cpus[NUMA_MAX_CPUS];			/* Cpus, ordered by node */
+static signed char cpu_node[NUMA_MAX_CPUS];	/* -1 if unknown */
+
+
+#ifdef __linux__
+
+/* Parse sysfs cpulist ("0-3,8-11") of node @node.
+ * Cpus not in @allowed are skipped. */
+static void
+numa_read_cpulist(int node, FILE *f, cpu_set_t *allowed)
+{
+	int a, b;
+	while (fscanf(f, "%d", &a) == 1) {
+		b = a;
+		if (fscanf(f, "-%d", &b) != 1)  b = a;
+		for (int c = a; c <= b && c < NUMA_MAX_CPUS; c++) {
+			if (cpu_node[c] >= 0)  continue;
+			if (allowed && (c >= CPU_SETSIZE || !CPU_ISSET(c, allowed)))  continue;
+			cpu_node[c] = node;
+			cpus[ncpus++] = c;
+		}
+		if (fgetc(f) != ',')  break;
+	}
+}
+
+void
+numa_setup(void)
+{
+	static bool done = false;
+	if (done)  return;
+	done = true;
+
+	memset(cpu_node, -1, sizeof(cpu_node));
+
+	/* Only hand out cpus we may run on (taskset, cgroup cpusets ...) */
+	cpu_set_t allowed;
+	bool have_allowed = !sched_getaffinity(0, sizeof(allowed), &allowed);
+
+	int n = 0;
+	for (int node = 0; node < NUMA_MAX_NODES; node++) {
+		char path[64];
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+		FILE *f = fopen(path, "r");
+		if (!f)  continue;
+		numa_read_cpulist(node, f, (have_allowed ? &allowed : NULL));
+		fclose(f);
+		n = node + 1;
+	}
+	nodes = (n ? n : 1);
+	if (DEBUGL(3))  fprintf(stderr, "numa: %d nodes, %d cpus\n", nodes, ncpus);
+}
+
+bool
+numa_pin_thread(pthread_t thread, int cpu)
+{
+	if (cpu < 0)  return false;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return !pthread_setaffinity_np(thread, sizeof(set), &set);
+}
+
+bool
+numa_mem_interleave(void *addr, size_t len)
+{
+	if (nodes < 2)  return false;
+	unsigned long mask[NUMA_MAX_NODES / (8 * sizeof(long))] = { 0 };
+	for (int i = 0; i < nodes; i++)
+		mask[i / (8 * sizeof(long))] |= 1UL << (i % (8 * sizeof(long)));
+
+	/* Range must start on a page boundary. */
+	size_t page = sysconf(_SC_PAGESIZE);
+	unsigned long start = (unsigned long)addr & ~(page - 1);
+	len += (unsigned long)addr - start;
+	return !syscall(SYS_mbind, start, len, MPOL_INTERLEAVE, mask, NUMA_MAX_NODES, 0);
+}
+
+int
+numa_mem_pages(void *addr, size_t len, int max_samples, int pages[NUMA_MAX_NODES])
+{
+	memset(pages, 0, NUMA_MAX_NODES * sizeof(int));
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t npages = len / page;
+	if (!npages)  return 0;
+	size_t step = (npages > (size_t)max_samples ? npages / max_samples : 1);
+	int n = npages / step;
+
+	void **p = (void **)cmalloc(n * sizeof(void *));
+	int *status = (int *)cmalloc(n * sizeof(int));
+	for (int i = 0; i < n; i++)
+		p[i] = (char *)addr + i * step * page;
+	int found = 0;
+	/* No target nodes: just query where pages are. */
+	if (!syscall(SYS_move_pages, 0, (unsigned long)n, p, NULL, status, 0))
+		for (int i = 0; i < n; i++)
+			if (status[i] >= 0 && status[i] < NUMA_MAX_NODES) {
+				pages[status[i]]++;
+				found++;
+			}
+	free(p);
+	free(status);
+	return found;
+}
+
+#else /* !__linux__ */
+
+void numa_setup(void)  {  memset(cpu_node, -1, sizeof(cpu_node));  }
+bool numa_pin_thread(pthread_t thread, int cpu)  {  return false;  }
+bool numa_mem_interleave(void *addr, size_t len)  {  return false;  }
+int  numa_mem_pages(void *addr, size_t len, int max_samples, int pages[NUMA_MAX_NODES])  {  return 0;  }
+
+#endif /* __linux__ */
+
+
+int
+numa_node_count(void)
+{
+	return nodes;
+}
+
+int
+numa_worker_cpu(int tid)
+{
+	if (!ncpus)  return -1;
+	return cpus[tid % ncpus];
+}
+
+int
+numa_cpu_to_node(int cpu)
+{
+	if (cpu < 0 || cpu >= NUMA_MAX_CPUS || cpu_node[cpu] < 0)
+		return 0;
+	return cpu_node[cpu];
+}
@@ -0,0 +1,39 @@
+#ifndef PACHI_NUMA_H
+#define PACHI_NUMA_H
+
+/* NUMA topology, thread placement and memory policy for the search.
+ * Linux only, using sysfs and raw syscalls (no libnuma needed).
+ * Elsewhere the machine is seen as a single node and placement
+ * functions do nothing. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#define NUMA_MAX_NODES 64
+
+/* Read topology, called once. */
+void numa_setup(void);
+
+/* Number of NUMA nodes (1 if unknown). */
+int numa_node_count(void);
+
+/* Cpu for worker @tid: cpus are handed out node by node so that
+ * workers share as few sockets as possible. Only cpus in the process
+ * affinity mask are used. -1 if unknown. */
+int numa_worker_cpu(int tid);
+int numa_cpu_to_node(int cpu);
+
+/* Pin @thread to @cpu. Returns false on failure. */
+bool numa_pin_thread(pthread_t thread, int cpu);
+
+/* Interleave pages of [addr, addr+len) over all nodes.
+ * Must be called before pages are touched. */
+bool numa_mem_interleave(void *addr, size_t len);
+
+/* Count pages of [addr, addr+len) on each node, sampling at most
+ * max_samples pages. Pages not faulted in yet are skipped.
+ * Returns number of pages found. */
+int numa_mem_pages(void *addr, size_t len, int max_samples, int pages[NUMA_MAX_NODES]);
+
+#endif /* PACHI_NUMA_H */
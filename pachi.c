@@ -35,6 +35,7 @@
 #include "pattern.h"
 #include "patternsp.h"
 #include "patternprob.h"
+#include "patternbin.h"
 #include "joseki.h"
 
 static void main_loop(gtp_t *gtp, board_t *b, engine_t *e, char *e_arg, time_info_t *ti, time_info_t *ti_default);
@@ -102,6 +103,8 @@ usage()
 		"  -h, --help                        show usage \n"
 		"  -s, --seed RANDOM_SEED            set random seed \n"
 		"  -u, --unit-test FILE              run unit tests \n"
+		"      --bench-playouts FILE         playout speed benchmark on positions in FILE \n"
+		"                                    args: playout=moggy|light,games=N,threads=N \n"
 		"  -v, --version                     show version \n"
 		"      --version=VERSION             version to return to gtp frontend \n"
 		"      --name=NAME                   name to return to gtp frontend \n"
@@ -131,12 +134,15 @@ usage()
 		"Engine components: \n"
 		"      --dcnn,     --nodcnn          dcnn required / disabled \n"
 		"      --patterns, --nopatterns      mm patterns required / disabled \n"
+		"      --compile-patterns[=FILE]     compile mm patterns for faster loading (default patterns_mm.bin) \n"
 		"      --joseki,   --nojoseki        joseki engine required / disabled \n"
 		" \n"
 #ifdef DCNN
 		"Deep learning: \n"
 		"      --dcnn=name                   choose which dcnn to load (default detlef) \n"
 		"      --dcnn=file                   \n"
+		"      --dcnn-backend=name           inference backend: caffe, cpu \n"
+		"      --dcnn-cache=N                cache N dcnn evaluations, 0 to disable (default 4096) \n"
 		"      --list-dcnns                  show supported networks \n"
 		" \n"
 #endif
@@ -201,13 +207,23 @@ show_version(FILE *s)
 #define OPT_KGS           268
 #define OPT_NAME          269
 #define OPT_LIST_DCNNS    270
+#define OPT_BENCH_PLAYOUTS 271
+#define OPT_DCNN_BACKEND  272
+#define OPT_COMPILE_PATTERNS 273
+#define OPT_DCNN_CACHE    274
 static struct option longopts[] = {
+	{ "bench-playouts", required_argument, 0, OPT_BENCH_PLAYOUTS },
 	{ "fuseki-time", required_argument, 0, OPT_FUSEKI_TIME },
 	{ "fuseki",      required_argument, 0, OPT_FUSEKI },
 	{ "chatfile",    required_argument, 0, 'c' },
 	{ "compile-flags", no_argument,     0, OPT_COMPILE_FLAGS },
+	{ "compile-patterns", optional_argument, 0, OPT_COMPILE_PATTERNS },
 	{ "debug-level", required_argument, 0, 'd' },
 	{ "dcnn",        optional_argument, 0, OPT_DCNN },
+#ifdef DCNN
+	{ "dcnn-backend", required_argument, 0, OPT_DCNN_BACKEND },
+	{ "dcnn-cache",  required_argument, 0, OPT_DCNN_CACHE },
+#endif
 	{ "engine",      required_argument, 0, 'e' },
 	{ "fbook",       required_argument, 0, 'f' },
 	{ "joseki",      no_argument,       0, OPT_JOSEKI },
@@ -246,6 +262,9 @@ int main(int argc, char *argv[])
 	time_info_t ti_default = ti_none;
 	int  seed = time(NULL) ^ getpid();
 	char *testfile = NULL;
+	char *benchfile = NULL;
+	bool compile_patterns = false;
+	char *patterns_bin = NULL;
 	char *log_port = NULL;
 	char *chatfile = NULL;
 	char *fbookfile = NULL;
@@ -288,6 +307,10 @@ int main(int argc, char *argv[])
 #endif
 				else die("%s: Invalid -e argument %s\n", argv[0], optarg);
 				break;
+			case OPT_COMPILE_PATTERNS:
+				compile_patterns = true;
+				if (optarg)  patterns_bin = strdup(optarg);
+				break;
 			case 'd':
 				debug_level = atoi(optarg);
 				break;
@@ -298,6 +321,12 @@ int main(int argc, char *argv[])
 				if (optarg)  set_dcnn(optarg);
 				require_dcnn();
 				break;
+			case OPT_DCNN_BACKEND:
+				set_dcnn_backend(optarg);
+				break;
+			case OPT_DCNN_CACHE:
+				set_dcnn_cache(atoi(optarg));
+				break;
 			case 'f':
 				fbookfile = strdup(optarg);
 				break;
@@ -385,6 +414,9 @@ int main(int argc, char *argv[])
 			case 'u':
 				testfile = strdup(optarg);
 				break;
+			case OPT_BENCH_PLAYOUTS:
+				benchfile = strdup(optarg);
+				break;
 			case OPT_VERBOSE_CAFFE:
 				verbose_caffe = true;
 				break;
@@ -406,6 +438,8 @@ int main(int argc, char *argv[])
 	if (!verbose_caffe)      quiet_caffe(argc, argv);
 	if (log_port)            open_log_port(log_port);
 	if (testfile)		 return unit_test(testfile);
+	if (benchfile)		 return bench_playouts(benchfile, (optind < argc ? argv[optind] : NULL));
+	if (compile_patterns)	 return patterns_compile(patterns_bin);
 	if (DEBUGL(0))           show_version(stderr);
 	if (getenv("DATA_DIR"))
 		if (DEBUGL(1))   fprintf(stderr, "Using data dir %s\n", getenv("DATA_DIR"));
@@ -223,8 +223,8 @@ patterns_init(pattern_config_t *pc, char *arg, bool create, bool load_prob)
 		}
 	}
 
-	/* Load spatial dictionary */
-	if (!spat_dict)  spatial_dict_init(pc, create);
+	/* Load spatial dictionary, compiled tables are only for matching. */
+	if (!spat_dict)  spatial_dict_init(pc, create, load_prob && !create);
 	if (!spat_dict)  return;
 
 	init_feature_info(pc);
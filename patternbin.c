@@ -0,0 +1,264 @@
+#define DEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "board.h"
+#include "debug.h"
+#include "pattern.h"
+#include "patternsp.h"
+#include "patternprob.h"
+#include "patternbin.h"
+
+/* File format (native endianness and struct layout, checked on load):
+ *   header                                see below
+ *   spatial_t       spatials[nspatials]   spatial records, id 0 is dummy
+ *   spatial_slot_t  slots[slots_mask + 1] open addressing hashtable (linear
+ *                                         probing) of all rotation hashes
+ *   uint32_t        first[nspatials + 2]  gamma groups, see patternprob.h
+ *   pattern_gamma_t gammas[ngammas]
+ * Sections are 64 bytes aligned. */
+
+#define PATTERN_BIN_MAGIC "PACHIPT1"
+#define PATTERN_BIN_ALIGN 64
+
+typedef struct {
+	char      magic[8];
+	uint32_t  abi;			/* struct sizes, see pattern_bin_abi() */
+	feature_t feature_check;	/* bitfield layout check */
+	hash_t    hash_check;		/* spatial hashing check */
+	uint32_t  nspatials;
+	uint32_t  nspatials_by_dist[MAX_PATTERN_DIST + 1];
+	uint32_t  slots_mask;
+	uint32_t  ngammas;
+	uint64_t  spatials_offset;
+	uint64_t  slots_offset;
+	uint64_t  first_offset;
+	uint64_t  gammas_offset;
+	uint64_t  size;			/* file size */
+} pattern_bin_header_t;
+
+static uint32_t
+pattern_bin_abi(void)
+{
+	return (sizeof(spatial_t) | sizeof(spatial_slot_t) << 8 |
+		sizeof(pattern_gamma_t) << 16 | MAX_PATTERN_DIST << 24);
+}
+
+static feature_t
+pattern_bin_feature_check(void)
+{
+	feature_t f = feature(FEAT_SPATIAL3, 0x123456);
+	return f;
+}
+
+static hash_t
+pattern_bin_hash_check(void)
+{
+	return pthashes[5][ptind[MAX_PATTERN_DIST]][S_WHITE];
+}
+
+static uint64_t
+pattern_bin_align(uint64_t offset)
+{
+	return (offset + PATTERN_BIN_ALIGN - 1) & ~(uint64_t)(PATTERN_BIN_ALIGN - 1);
+}
+
+
+/**********************************************************************************/
+/* Loading */
+
+#ifndef _WIN32
+
+/* Is data file @name newer than @mtime ? */
+static bool
+newer_data_file(const char *name, time_t mtime)
+{
+	char path[256];  get_data_file(path, name);
+	struct stat st;
+	return (stat(path, &st) == 0 && st.st_mtime > mtime);
+}
+
+static bool
+pattern_bin_check(pattern_bin_header_t *h, size_t size)
+{
+	feature_t f = pattern_bin_feature_check();
+	if (size < sizeof(*h) || memcmp(h->magic, PATTERN_BIN_MAGIC, sizeof(h->magic)))
+		return false;
+	if (h->abi != pattern_bin_abi() || memcmp(&h->feature_check, &f, sizeof(f)) ||
+	    h->hash_check != pattern_bin_hash_check() || h->size != size)
+		return false;
+
+	/* Sections must fit in the file, in order. */
+	uint64_t spatials_end = h->spatials_offset + (uint64_t)h->nspatials * sizeof(spatial_t);
+	uint64_t slots_end = h->slots_offset + ((uint64_t)h->slots_mask + 1) * sizeof(spatial_slot_t);
+	uint64_t first_end = h->first_offset + ((uint64_t)h->nspatials + 2) * sizeof(uint32_t);
+	uint64_t gammas_end = h->gammas_offset + (uint64_t)h->ngammas * sizeof(pattern_gamma_t);
+	return (h->nspatials > 0 && (h->slots_mask & (h->slots_mask + 1)) == 0 &&
+		h->spatials_offset >= sizeof(*h) && h->slots_offset >= spatials_end &&
+		h->first_offset >= slots_end && h->gammas_offset >= first_end && gammas_end <= size);
+}
+
+bool
+spatial_dict_load_bin(pattern_config_t *pc)
+{
+	char path[256];  get_data_file(path, PATTERN_BIN_FILENAME);
+	struct stat st;
+	if (stat(path, &st) != 0)
+		return false;
+
+	if (newer_data_file(spatial_dict_filename, st.st_mtime) ||
+	    newer_data_file("patterns_mm.gamma", st.st_mtime)) {
+		if (DEBUGL(1))  fprintf(stderr, "%s is older than text patterns, ignoring it.\n", path);
+		return false;
+	}
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)  return false;
+	size_t size = st.st_size;
+	void *map = (size ? mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED);
+	close(fd);
+	if (map == MAP_FAILED) {
+		if (DEBUGL(1))  fprintf(stderr, "%s: couldn't map file, ignoring it.\n", path);
+		return false;
+	}
+
+	pattern_bin_header_t *h = (pattern_bin_header_t *)map;
+	if (!pattern_bin_check(h, size)) {
+		if (DEBUGL(1))  fprintf(stderr, "%s: bad or incompatible file, ignoring it.\n"
+					        "Regenerate it with 'pachi --compile-patterns'\n", path);
+		munmap(map, size);
+		return false;
+	}
+
+	spat_dict = calloc2(1, spatial_dict_t);
+	spat_dict->map = map;
+	spat_dict->map_size = size;
+	spat_dict->nspatials = h->nspatials;
+	spat_dict->spatials = (spatial_t *)((char *)map + h->spatials_offset);
+	spat_dict->slots = (spatial_slot_t *)((char *)map + h->slots_offset);
+	spat_dict->slots_mask = h->slots_mask;
+	memcpy(spat_dict->nspatials_by_dist, h->nspatials_by_dist, sizeof(h->nspatials_by_dist));
+
+	if (DEBUGL(1))  fprintf(stderr, "Loaded spatial dictionary of %d patterns (%s).\n", h->nspatials, path);
+	return true;
+}
+
+void
+prob_dict_load_bin(pattern_config_t *pc)
+{
+	assert(spat_dict && spat_dict->map);
+	pattern_bin_header_t *h = (pattern_bin_header_t *)spat_dict->map;
+
+	prob_dict = calloc2(1, prob_dict_t);
+	prob_dict->mapped = true;
+	prob_dict->ngammas = h->ngammas;
+	prob_dict->first = (uint32_t *)((char *)spat_dict->map + h->first_offset);
+	prob_dict->gammas = (pattern_gamma_t *)((char *)spat_dict->map + h->gammas_offset);
+
+	if (DEBUGL(1))  fprintf(stderr, "Loaded %d gammas.\n", h->ngammas);
+}
+
+void
+pattern_bin_unmap(void *map, size_t size)
+{
+	munmap(map, size);
+}
+
+#else /* _WIN32 */
+
+/* No mmap(), always use text files. */
+bool spatial_dict_load_bin(pattern_config_t *pc)  {  return false;  }
+void prob_dict_load_bin(pattern_config_t *pc)     {  assert(0);  }
+void pattern_bin_unmap(void *map, size_t size)    {  assert(0);  }
+
+#endif /* _WIN32 */
+
+
+/**********************************************************************************/
+/* Compilation */
+
+/* Insert rotation hash unless lookup would already find a spatial
+ * for it. Spatials are inserted by decreasing id so that lookups give
+ * the same results as with the chained hashtable (last added wins). */
+static void
+slots_insert(spatial_slot_t *slots, unsigned int mask, hash_t hash, unsigned int id)
+{
+	unsigned int dist = spat_dict->spatials[id].dist;
+	unsigned int i = hash & mask;
+	for (; slots[i].id; i = (i + 1) & mask)
+		if (slots[i].hash == hash && spat_dict->spatials[slots[i].id].dist == dist)
+			return;
+	slots[i].hash = hash;
+	slots[i].id = id;
+}
+
+static void
+write_section(FILE *f, uint64_t offset, const void *data, size_t size, char *filename)
+{
+	if (fseek(f, offset, SEEK_SET) || fwrite(data, 1, size, f) != size)
+		fail(filename);
+}
+
+int
+patterns_compile(char *filename)
+{
+	if (!filename)  filename = (char *)PATTERN_BIN_FILENAME;
+
+	/* Load text dictionaries */
+	pattern_config_t pc;
+	patterns_init(&pc, NULL, true, true);
+	if (!spat_dict || spat_dict->nspatials <= 1 || !prob_dict)
+		die("couldn't load %s and patterns_mm.gamma, aborting.\n", spatial_dict_filename);
+
+	/* Hashtable at most 1/2 full. */
+	unsigned int entries = (spat_dict->nspatials - 1) * PTH__ROTATIONS;
+	unsigned int nslots = 1;
+	while (nslots < 2 * entries)  nslots *= 2;
+	spatial_slot_t *slots = calloc2(nslots, spatial_slot_t);
+	for (unsigned int id = spat_dict->nspatials - 1; id > 0; id--)
+		for (unsigned int r = 0; r < PTH__ROTATIONS; r++)
+			slots_insert(slots, nslots - 1, spatial_hash(r, &spat_dict->spatials[id]), id);
+
+	pattern_bin_header_t h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, PATTERN_BIN_MAGIC, sizeof(h.magic));
+	h.abi = pattern_bin_abi();
+	h.feature_check = pattern_bin_feature_check();
+	h.hash_check = pattern_bin_hash_check();
+	h.nspatials = spat_dict->nspatials;
+	memcpy(h.nspatials_by_dist, spat_dict->nspatials_by_dist, sizeof(h.nspatials_by_dist));
+	h.slots_mask = nslots - 1;
+	h.ngammas = prob_dict->ngammas;
+	h.spatials_offset = pattern_bin_align(sizeof(h));
+	h.slots_offset = pattern_bin_align(h.spatials_offset + (uint64_t)h.nspatials * sizeof(spatial_t));
+	h.first_offset = pattern_bin_align(h.slots_offset + (uint64_t)nslots * sizeof(spatial_slot_t));
+	h.gammas_offset = pattern_bin_align(h.first_offset + ((uint64_t)h.nspatials + 2) * sizeof(uint32_t));
+	h.size = h.gammas_offset + (uint64_t)h.ngammas * sizeof(pattern_gamma_t);
+
+	/* Write to a temporary file and rename it: other processes may
+	 * have the old file mapped. */
+	char tmp[256];
+	snprintf(tmp, sizeof(tmp), "%s.tmp", filename);
+	FILE *f = fopen(tmp, "wb");
+	if (!f)  fail(tmp);
+	write_section(f, 0, &h, sizeof(h), tmp);
+	write_section(f, h.spatials_offset, spat_dict->spatials, h.nspatials * sizeof(spatial_t), tmp);
+	write_section(f, h.slots_offset, slots, nslots * sizeof(spatial_slot_t), tmp);
+	write_section(f, h.first_offset, prob_dict->first, (h.nspatials + 2) * sizeof(uint32_t), tmp);
+	write_section(f, h.gammas_offset, prob_dict->gammas, h.ngammas * sizeof(pattern_gamma_t), tmp);
+	if (fclose(f))  fail(tmp);
+	if (rename(tmp, filename))  fail(filename);
+	free(slots);
+
+	fprintf(stderr, "Wrote %s: %d spatials, %d gammas, %.1fMb\n", filename,
+		h.nspatials, h.ngammas, (double)h.size / (1024 * 1024));
+	return 0;
+}
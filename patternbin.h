@@ -0,0 +1,32 @@
+#ifndef PACHI_PATTERNBIN_H
+#define PACHI_PATTERNBIN_H
+
+/* Compiled pattern tables. */
+
+#include "pattern.h"
+
+/* Parsing the text dictionaries (patterns_mm.spat, patterns_mm.gamma)
+ * takes a while and each process ends up with its own copy. Instead they
+ * can be compiled once (pachi --compile-patterns) into a binary file that
+ * is mapped read-only at startup and used in place: spatial records,
+ * open addressing hashtable and gamma arrays are all stored ready to use,
+ * so Pachi instances running on the same host share the same pages.
+ * The text files are used if the binary file is missing, older than them,
+ * or was produced by an incompatible build. */
+
+#define PATTERN_BIN_FILENAME "patterns_mm.bin"
+
+/* Map compiled tables and set up spat_dict from them.
+ * Returns false if not available. */
+bool spatial_dict_load_bin(pattern_config_t *pc);
+
+/* Set up prob_dict from compiled tables mapped by spatial_dict_load_bin(). */
+void prob_dict_load_bin(pattern_config_t *pc);
+
+void pattern_bin_unmap(void *map, size_t size);
+
+/* Load text dictionaries and write compiled tables to @filename
+ * (default PATTERN_BIN_FILENAME). Returns exit status. */
+int patterns_compile(char *filename);
+
+#endif
@@ -3,20 +3,53 @@
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "board.h"
 #include "debug.h"
 #include "pattern.h"
 #include "patternsp.h"
 #include "patternprob.h"
+#include "patternbin.h"
 #include "engine.h"
 
 prob_dict_t    *prob_dict = NULL;
 
+/* Group gammas by spatial id (counting sort), checking for duplicates. */
+static void
+prob_dict_index(char *filename, pattern_gamma_t *gammas, uint32_t *spis, unsigned int n)
+{
+	unsigned int nspatials = spat_dict->nspatials;
+	uint32_t *first = prob_dict->first = calloc2(nspatials + 2, uint32_t);
+	prob_dict->gammas = (pattern_gamma_t*)cmalloc((n ? n : 1) * sizeof(pattern_gamma_t));
+	prob_dict->ngammas = n;
+
+	for (unsigned int i = 0; i < n; i++)
+		first[spis[i] + 1]++;
+	for (unsigned int spi = 0; spi <= nspatials; spi++)
+		first[spi + 1] += first[spi];
+
+	uint32_t *next = calloc2(nspatials + 1, uint32_t);
+	memcpy(next, first, (nspatials + 1) * sizeof(*next));
+	for (unsigned int i = 0; i < n; i++) {
+		uint32_t spi = spis[i];
+		for (uint32_t j = first[spi]; j < next[spi]; j++)
+			if (feature_eq(&prob_dict->gammas[j].f, &gammas[i].f))
+				die("%s: multiple gammas for feature %s\n", filename, feature2sstr(&gammas[i].f));
+		prob_dict->gammas[next[spi]++] = gammas[i];
+	}
+	free(next);
+}
+
 void
 prob_dict_init(char *filename, pattern_config_t *pc)
 {
 	assert(!prob_dict);
+	if (!filename && spat_dict->map) {
+		prob_dict_load_bin(pc);
+		return;
+	}
+
 	if (!filename)  filename = "patterns_mm.gamma";
 	FILE *f = fopen_data_file(filename, "r");
 	if (!f) {
@@ -25,35 +58,41 @@ prob_dict_init(char *filename, pattern_config_t *pc)
 	}
 
 	prob_dict = calloc2(1, prob_dict_t);
-	prob_dict->table = calloc2(spat_dict->nspatials + 1, pattern_prob_t*);
 
-	int i = 0;
+	unsigned int n = 0, alloc = 0;
+	pattern_gamma_t *gammas = NULL;
+	uint32_t *spis = NULL;
 	char sbuf[1024];
 	while (fgets(sbuf, sizeof(sbuf), f)) {
-		pattern_prob_t *pb = calloc2(1, pattern_prob_t);
-		//int c, o;
-
 		char *buf = sbuf;
 		if (buf[0] == '#') continue;
 		while (isspace(*buf)) buf++;
 		float gamma = strtof(buf, &buf);
-		pb->gamma = gamma;
 		while (isspace(*buf)) buf++;
-		str2pattern(buf, &pb->p);
-		assert(pb->p.n == 1);				/* One gamma per feature, please ! */
+		pattern_t p;
+		str2pattern(buf, &p);
+		assert(p.n == 1);				/* One gamma per feature, please ! */
 
-		uint32_t spi = feature2spatial(pc, &pb->p.f[0]);
+		uint32_t spi = feature2spatial(pc, &p.f[0]);
 		assert(spi <= spat_dict->nspatials);		/* Bad patterns.spat / patterns.prob ? */
-		if (feature_has_gamma(pc, &pb->p.f[0]))
-			die("%s: multiple gammas for feature %s\n", filename, pattern2sstr(&pb->p));
-		pb->next = prob_dict->table[spi];
-		prob_dict->table[spi] = pb;
 
-		i++;
+		if (n == alloc) {
+			alloc = (alloc ? alloc * 2 : 65536);
+			gammas = (pattern_gamma_t*)realloc(gammas, alloc * sizeof(*gammas));
+			spis = (uint32_t*)realloc(spis, alloc * sizeof(*spis));
+			if (!gammas || !spis)  die("%s: out of memory\n", filename);
+		}
+		gammas[n].f = p.f[0];
+		gammas[n].gamma = gamma;
+		spis[n] = spi;
+		n++;
 	}
-
 	fclose(f);
-	if (DEBUGL(1))  fprintf(stderr, "Loaded %d gammas.\n", i);
+
+	prob_dict_index(filename, gammas, spis, n);
+	free(gammas);
+	free(spis);
+	if (DEBUGL(1))  fprintf(stderr, "Loaded %d gammas.\n", n);
 }
 
 void
@@ -61,9 +100,10 @@ prob_dict_done()
 {
 	if (!prob_dict)  return;
 
-	for (unsigned int id = 0; id < spat_dict->nspatials; id++)
-		free(prob_dict->table[id]);
-	free(prob_dict->table);
+	if (!prob_dict->mapped) {
+		free(prob_dict->first);
+		free(prob_dict->gammas);
+	}
 	free(prob_dict);
 	prob_dict = NULL;
 }
@@ -208,8 +248,9 @@ bool
 feature_has_gamma(pattern_config_t *pc, feature_t *f)
 {
 	uint32_t spi = feature2spatial(pc, f);
-	for (pattern_prob_t *pb = prob_dict->table[spi]; pb; pb = pb->next)
-		if (feature_eq(f, &pb->p.f[0]))
+	pattern_gamma_t *end = prob_dict->gammas + prob_dict->first[spi + 1];
+	for (pattern_gamma_t *g = prob_dict->gammas + prob_dict->first[spi]; g < end; g++)
+		if (feature_eq(f, &g->f))
 			return true;
 	return false;
 }
@@ -14,17 +14,20 @@
  * of the pattern being played. */
 
 /* The table primary key is the pattern spatial (most distinctive
- * feature); within a single primary key chain, the entries are
- * unsorted (for now). */
+ * feature); gammas with the same primary key are stored contiguously
+ * (unsorted for now), gammas[first[spi] .. first[spi+1]) for spatial
+ * id spi. Non-spatial features come last, under spatial id nspatials. */
 
-typedef struct pattern_prob {
-	pattern_t p;
-	floating_t gamma;
-	struct pattern_prob *next;
-} pattern_prob_t;
+typedef struct {
+	feature_t f;
+	float gamma;
+} pattern_gamma_t;
 
 typedef struct {
-	pattern_prob_t **table; /* [pc->spat_dict->nspatials + 1] */
+	unsigned int ngammas;
+	pattern_gamma_t *gammas;	/* [ngammas] */
+	uint32_t *first;		/* [spat_dict->nspatials + 2] */
+	bool mapped;			/* Arrays live in compiled tables, see patternbin.h */
 } prob_dict_t;
 
 /* The patterns probability dictionary */
@@ -85,9 +88,10 @@ static inline floating_t
 feature_gamma(pattern_config_t *pc, feature_t *f)
 {
 	uint32_t spi = feature2spatial(pc, f);
-	for (pattern_prob_t *pb = prob_dict->table[spi]; pb; pb = pb->next)
-		if (feature_eq(f, &pb->p.f[0]))
-			return pb->gamma;
+	pattern_gamma_t *end = prob_dict->gammas + prob_dict->first[spi + 1];
+	for (pattern_gamma_t *g = prob_dict->gammas + prob_dict->first[spi]; g < end; g++)
+		if (feature_eq(f, &g->f))
+			return g->gamma;
 	die("no gamma for feature (%s) !\n", feature2sstr(f));
 	//return NAN; // XXX: We assume quiet NAN existence
 }
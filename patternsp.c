@@ -9,6 +9,7 @@
 #include "debug.h"
 #include "pattern.h"
 #include "patternsp.h"
+#include "patternbin.h"
 
 /* Mapping from point sequence to coordinate offsets (to determine
  * coordinates relative to pattern center). The array is ordered
@@ -287,6 +288,16 @@ spatial_dict_hash(hash_t h) {  return h & spatial_hash_mask;  }
 spatial_t*
 spatial_dict_lookup(spatial_dict_t *dict, int dist, hash_t hash)
 {
+	if (dict->slots) {
+		/* Compiled dictionary: linear probing. */
+		for (unsigned int i = hash & dict->slots_mask; dict->slots[i].id; i = (i + 1) & dict->slots_mask) {
+			spatial_slot_t *e = &dict->slots[i];
+			if (e->hash == hash && spatial(e->id, dict)->dist == dist)
+				return spatial(e->id, dict);
+		}
+		return NULL;
+	}
+
 	spatial_entry_t *e = dict->hashtable[spatial_dict_hash(hash)];
 	for (; e ; e = e->next)
 		if (e->hash == hash && spatial(e->id, dict)->dist == dist)
@@ -332,6 +343,8 @@ spatial_dict_add(spatial_dict_t *dict, spatial_t *s)
 		assert(spatial_equal(s, s2));	/* Sanity check */
 		return spatial_id(s2, dict);	/* Already have */
 	}
+	if (dict->map)
+		die("spatial dictionary: can't add patterns to compiled dictionary\n");
 
 	/* Add to collection */
 	unsigned int id = spatial_dict_addc(dict, s);
@@ -439,8 +452,8 @@ spatial_dict_hashstats(spatial_dict_t *dict)
 		if (n < 10)  stats[n]++;
 	}
 
-	unsigned int buckets = (sizeof(dict->hashtable) / sizeof(dict->hashtable[0]));
-	unsigned int htmem = sizeof(dict->hashtable);
+	unsigned int buckets = 1 << spatial_hash_bits;
+	unsigned int htmem = buckets * sizeof(dict->hashtable[0]);
 	unsigned int mem = htmem + dict->nspatials * sizeof(spatial_t) + entries * sizeof(spatial_entry_t);
 	fprintf(stderr, "Spatial hash: %i entries, empty %.1f%%, avg len %.1f,   %.1fMb (%.1fMb total)\n",
 			entries,
@@ -496,9 +509,12 @@ spatial_dict_index_by_dist(pattern_config_t *pc)
 const char *spatial_dict_filename = "patterns_mm.spat";
 
 void
-spatial_dict_init(pattern_config_t *pc, bool create)
+spatial_dict_init(pattern_config_t *pc, bool create, bool binary)
 {
-	assert(!spat_dict);	
+	assert(!spat_dict);
+	if (binary && spatial_dict_load_bin(pc))
+		return;
+
 	FILE *f = fopen_data_file(spatial_dict_filename, "r");
 	if (!f && !create) {
 		if (DEBUGL(1)) fprintf(stderr, "%s not found, mm patterns disabled.\n", spatial_dict_filename);
@@ -506,6 +522,7 @@ spatial_dict_init(pattern_config_t *pc, bool create)
 	}
 
 	spat_dict = calloc2(1, spatial_dict_t);
+	spat_dict->hashtable = calloc2(1 << spatial_hash_bits, spatial_entry_t*);
 	/* Dummy record for index 0 so ids start at 1. */
 	spatial_t dummy = { 0, };
 	spatial_dict_addc(spat_dict, &dummy);
@@ -521,6 +538,13 @@ void
 spatial_dict_done()
 {
 	if (!spat_dict)  return;
+
+	if (spat_dict->map) {
+		pattern_bin_unmap(spat_dict->map, spat_dict->map_size);
+		free(spat_dict);
+		spat_dict = NULL;
+		return;
+	}
 	
 	free(spat_dict->spatials);
 	
@@ -531,6 +555,7 @@ spatial_dict_done()
 			free(e);
 		}
 
+	free(spat_dict->hashtable);
 	free(spat_dict);
 	spat_dict = NULL;
 }
@@ -77,6 +77,13 @@ typedef struct spatial_entry {
 	struct spatial_entry *next;	/* next entry with same hash */
 } spatial_entry_t;
 
+/* Open addressing hashtable slot, for compiled dictionaries.
+ * id 0 (dummy record) marks an empty slot. */
+typedef struct {
+	hash_t hash;
+	unsigned int id;
+} spatial_slot_t;
+
 typedef struct {
 	/* Indexed base store */
 	unsigned int nspatials; /* Number of records. */
@@ -86,8 +93,16 @@ typedef struct {
 	unsigned int     nspatials_by_dist[MAX_PATTERN_DIST+1];
 
 	/* Hashed access (all isomorphous configurations are also hashed)
-	 * Maps to spatials[] indices. Hash function: zobrist hashing with fixed values. */
-	spatial_entry_t* hashtable[1 << spatial_hash_bits];
+	 * Maps to spatials[] indices. Hash function: zobrist hashing with fixed values.
+	 * Either chained hashtable[1 << spatial_hash_bits] (text dictionary, can grow)
+	 * or slots[slots_mask + 1] (compiled dictionary, read-only). */
+	spatial_entry_t **hashtable;
+	spatial_slot_t *slots;
+	unsigned int slots_mask;
+
+	/* Compiled dictionary mapping, see patternbin.h */
+	void *map;
+	size_t map_size;
 } spatial_dict_t;
 
 extern spatial_dict_t *spat_dict;
@@ -138,9 +153,9 @@ extern hash_t pthashes[PTH__ROTATIONS][MAX_PATTERN_AREA][S_MAX];
 /* Initializes spatial dictionary, pre-loading existing records from
  * default filename if exists. If create is true, it will not complain
  * about non-existing file and initialize the dictionary anyway.
- * If hash is true, loaded spatials will be added to the hashtable;
- * use false if this is to be done later (e.g. by patternprob). */
-void spatial_dict_init(pattern_config_t *pc, bool create);
+ * If binary is true and compiled pattern tables are available, map
+ * them instead of parsing the text file: dictionary is read-only then. */
+void spatial_dict_init(pattern_config_t *pc, bool create, bool binary);
 
 /* Free spatial dictionary. */
 void spatial_dict_done();
@@ -149,7 +164,7 @@ void spatial_dict_done();
 spatial_t *spatial_dict_lookup(spatial_dict_t *dict, int dist, hash_t spatial_hash);
 
 /* Store specified spatial pattern in the dictionary if it is not known yet.
- * Returns spatial id. */
+ * Returns spatial id. Not for compiled dictionaries. */
 unsigned int spatial_dict_add(spatial_dict_t *dict, spatial_t *s);
 
 /* Write comment lines describing the dictionary (e.g. point order
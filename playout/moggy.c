@@ -418,6 +418,16 @@ local_2lib_capture_check(playout_policy_t *p, board_t *b, move_t *m, move_queue_
 		mq_print(q, "Local 2lib capture");
 }
 
+/* Does group @g have at most nlib_count liberties ? Liberty count in group
+ * info may be short of the real one past GROUP_REFILL_LIBS, so check the
+ * exact count then (free with default nlib_count). */
+static bool
+nlib_group(moggy_policy_t *pp, board_t *b, group_t g)
+{
+	return (board_group_info(b, g).libs <= pp->nlib_count &&
+		board_group_libs_exact(b, g) <= pp->nlib_count);
+}
+
 static void
 local_nlib_check(playout_policy_t *p, board_t *b, move_t *m, move_queue_t *q)
 {
@@ -457,7 +467,7 @@ local_nlib_check(playout_policy_t *p, board_t *b, move_t *m, move_queue_t *q)
 		group_t g = group_at(b, c);
 		if (!g || group2 == g || board_at(b, c) != color)
 			continue;
-		if (board_group_info(b, g).libs < 3 || board_group_info(b, g).libs > pp->nlib_count)
+		if (board_group_info(b, g).libs < 3 || !nlib_group(pp, b, g))
 			continue;
 		group_nlib_defense_check(b, g, color, q, 1<<MQ_LNLIB);
 		group2 = g; // prevent trivial repeated checks
@@ -875,7 +885,7 @@ playout_moggy_assess_group(playout_policy_t *p, prior_map_t *map, group_t g, int
 	board_t *b = map->b;
 	move_queue_t q;  mq_init(&q);
 
-	if (board_group_info(b, g).libs > pp->nlib_count)
+	if (!nlib_group(pp, b, g))
 		return;
 
 	if (PLDEBUGL(5)) {
@@ -2,12 +2,34 @@
 #define PACHI_STATS_H
 
 #include <math.h>
+#include <stdint.h>
 
 /* Move statistics; we track how good value each move has. */
 /* These operations are supposed to be atomic - reasonably
  * safe to perform by multiple threads at once on the same stats.
  * What this means in practice is that perhaps the value will get
- * slightly wrong, but not drastically corrupted. */
+ * slightly wrong, but not drastically corrupted.
+ * With ATOMIC_STATS, value and playouts share a single 64-bit word
+ * which is updated with one compare-and-swap, so they always stay
+ * consistent and no update gets lost. */
+
+#ifdef ATOMIC_STATS
+
+#ifdef DOUBLE_FLOATING
+#error "ATOMIC_STATS needs value and playouts to fit in 64 bits, can't be used with DOUBLE_FLOATING"
+#endif
+
+typedef union {
+	struct {
+		floating_t value; // BLACK wins/playouts
+		int playouts; // # of playouts
+	};
+	uint64_t packed;
+} move_stats_t;
+
+#define move_stats(value, playouts)  { { value, playouts } }
+
+#else
 
 typedef struct {
 	floating_t value; // BLACK wins/playouts
@@ -16,6 +38,8 @@ typedef struct {
 
 #define move_stats(value, playouts)  { value, playouts }
 
+#endif
+
 /* Add a result to the stats. */
 static void stats_add_result(move_stats_t *s, floating_t result, int playouts);
 
@@ -29,6 +53,41 @@ static void stats_merge(move_stats_t *dest, move_stats_t *src);
 static void stats_reverse_parity(move_stats_t *s);
 
 
+#ifdef ATOMIC_STATS
+
+/* Compute the new stats from a snapshot of the old ones and publish
+ * them only if nobody updated the stats in between, otherwise retry. */
+
+static inline void
+stats_add_result(move_stats_t *s, floating_t result, int playouts)
+{
+	move_stats_t old, new;
+	do {
+		old.packed = *(volatile uint64_t *)&s->packed;
+		new.playouts = old.playouts + playouts;
+		new.value = old.value + (result - old.value) * playouts / new.playouts;
+	} while (!__sync_bool_compare_and_swap(&s->packed, old.packed, new.packed));
+}
+
+static inline void
+stats_rm_result(move_stats_t *s, floating_t result, int playouts)
+{
+	move_stats_t old, new;
+	do {
+		old.packed = *(volatile uint64_t *)&s->packed;
+		if (old.playouts > playouts) {
+			new.playouts = old.playouts - playouts;
+			new.value = old.value + (old.value - result) * playouts / new.playouts;
+		} else {
+			/* Same as below, keep the value with zero playouts. */
+			new.playouts = 0;
+			new.value = old.value;
+		}
+	} while (!__sync_bool_compare_and_swap(&s->packed, old.packed, new.packed));
+}
+
+#else
+
 /* We actually do the atomicity in a pretty hackish way - we simply
  * rely on the fact that int,floating_t operations should be atomic with
  * reasonable compilers (gcc) on reasonable architectures (i386,
@@ -84,6 +143,8 @@ stats_rm_result(move_stats_t *s, floating_t result, int playouts)
 	}
 }
 
+#endif /* ATOMIC_STATS */
+
 static inline void
 stats_merge(move_stats_t *dest, move_stats_t *src)
 {
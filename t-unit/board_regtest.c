@@ -41,6 +41,24 @@
 
 static void print_board_flags(board_t *b);
 
+#ifdef BOARD_LIBSET
+/* Liberties the slow way, to check liberty sets. */
+static int
+group_libs_scan(board_t *b, group_t g)
+{
+	int libs = 0;
+	int seen[BOARD_MAX_COORDS] = { 0, };
+	foreach_in_group(b, g) {
+		foreach_neighbor(b, c, {
+			if (board_at(b, c) != S_NONE || seen[c])  continue;
+			seen[c] = 1;
+			libs++;
+		});
+	} foreach_in_group_end;
+	return libs;
+}
+#endif
+
 static unsigned char*
 hash_board_statics(board_t *b)
 {
@@ -118,6 +136,9 @@ hash_board(board_t *b)
 		hash_int(c);
 		for (int i = 0; i < board_group_info(b, g).libs; i++)
 			hash_int(board_group_info(b, g).lib[i]);
+#ifdef BOARD_LIBSET
+		assert(board_group_libs_exact(b, g) == group_libs_scan(b, g));  /* sanity check ... */
+#endif
 	} foreach_point_end;
 
 
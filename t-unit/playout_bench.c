@@ -0,0 +1,238 @@
+#define DEBUG
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "board.h"
+#include "debug.h"
+#include "playout.h"
+#include "playout/light.h"
+#include "playout/moggy.h"
+#include "random.h"
+#include "timeinfo.h"
+#include "t-unit/test.h"
+
+/* Playout throughput benchmark:
+ *
+ *   pachi --bench-playouts FILE [playout=moggy|light[:args],games=N,threads=N,gamelen=N]
+ *
+ * FILE holds positions in t-unit format (boardsize line followed by the
+ * board diagram, see t-unit/README), all of the same size. For each thread
+ * count 1, 2, 4 ... up to threads, we play games playouts from each position
+ * (split among threads) and report playouts/s and average game length.
+ * A last single threaded run times the policy choose() and permit()
+ * callbacks to show where time goes (timing adds some overhead there).
+ * Random seeds are fixed so runs are reproducible. */
+
+#define BENCH_MAX_POSITIONS 64
+
+typedef struct {
+	board_t *positions[BENCH_MAX_POSITIONS];
+	int npositions;
+	playout_policy_t *policy;
+	int games;
+	int gamelen;
+} bench_t;
+
+typedef struct {
+	bench_t *bench;
+	playout_policy_t *policy;
+	int tid, threads;
+	long long moves;
+	int games;
+} bench_thread_t;
+
+/* Color to play in loaded position. */
+static enum stone
+bench_to_play(board_t *b)
+{
+	return (last_move(b).color == S_BLACK ? S_WHITE : S_BLACK);
+}
+
+static void *
+bench_worker(void *ctx_)
+{
+	bench_thread_t *ctx = (bench_thread_t*)ctx_;
+	bench_t *bench = ctx->bench;
+	fast_srandom(29264 + ctx->tid);
+
+	playout_setup_t setup = playout_setup(bench->gamelen, 0);
+	for (int p = 0; p < bench->npositions; p++) {
+		board_t *pos = bench->positions[p];
+		enum stone color = bench_to_play(pos);
+		for (int i = ctx->tid; i < bench->games; i += ctx->threads) {
+			board_t b;
+			board_copy(&b, pos);
+			playout_play_game(&setup, &b, color, NULL, NULL, ctx->policy);
+			ctx->moves += b.moves - pos->moves;
+			ctx->games++;
+			board_done(&b);
+		}
+	}
+	return NULL;
+}
+
+/* Run benchmark with given number of threads, returns elapsed time. */
+static double
+bench_run(bench_t *bench, playout_policy_t *policy, int threads, int *games, long long *moves)
+{
+	pthread_t ids[threads];
+	bench_thread_t ctx[threads];
+	memset(ctx, 0, sizeof(ctx));
+
+	double start = time_now();
+	for (int i = 0; i < threads; i++) {
+		ctx[i].bench = bench;
+		ctx[i].policy = policy;
+		ctx[i].tid = i;
+		ctx[i].threads = threads;
+		pthread_create(&ids[i], NULL, bench_worker, &ctx[i]);
+	}
+	*games = 0;  *moves = 0;
+	for (int i = 0; i < threads; i++) {
+		pthread_join(ids[i], NULL);
+		*games += ctx[i].games;
+		*moves += ctx[i].moves;
+	}
+	return time_now() - start;
+}
+
+
+/* Per-phase timing, single threaded: wrap policy callbacks.
+ * permit() calls made from within choose() are accounted to choose(). */
+
+static playout_policy_t *timed_policy;
+static double choose_time, permit_time;
+static bool in_choose;
+
+static coord_t
+timed_choose(playout_policy_t *p, playout_setup_t *s, board_t *b, enum stone to_play)
+{
+	double start = time_now();
+	in_choose = true;
+	coord_t c = timed_policy->choose(p, s, b, to_play);
+	in_choose = false;
+	choose_time += time_now() - start;
+	return c;
+}
+
+static bool
+timed_permit(playout_policy_t *p, board_t *b, move_t *m, bool alt, bool rnd)
+{
+	if (in_choose)
+		return timed_policy->permit(p, b, m, alt, rnd);
+	double start = time_now();
+	bool r = timed_policy->permit(p, b, m, alt, rnd);
+	permit_time += time_now() - start;
+	return r;
+}
+
+static void
+bench_phases(bench_t *bench)
+{
+	playout_policy_t timed = *bench->policy;
+	timed_policy = bench->policy;
+	timed.choose = timed_choose;
+	if (timed.permit)  timed.permit = timed_permit;
+	choose_time = permit_time = 0;
+
+	int games;  long long moves;
+	double elapsed = bench_run(bench, &timed, 1, &games, &moves);
+	double board_time = elapsed - choose_time - permit_time;
+	printf("\nPer-phase time (1 thread, %.2f us/move):\n", elapsed * 1e6 / moves);
+	printf("  choose  %5.1f%%  %6.2f us/move\n", choose_time * 100 / elapsed, choose_time * 1e6 / moves);
+	printf("  permit  %5.1f%%  %6.2f us/move\n", permit_time * 100 / elapsed, permit_time * 1e6 / moves);
+	printf("  board   %5.1f%%  %6.2f us/move   (board_play, random moves, scoring)\n",
+	       board_time * 100 / elapsed, board_time * 1e6 / moves);
+}
+
+
+static void
+bench_load_positions(bench_t *bench, char *filename)
+{
+	FILE *f = fopen(filename, "r");
+	if (!f)  fail(filename);
+
+	char line[256];
+	while (fgets(line, sizeof(line), f)) {
+		if (strncmp(line, "boardsize ", 10))
+			continue;
+		if (bench->npositions == BENCH_MAX_POSITIONS)
+			die("%s: too many positions (max %d)\n", filename, BENCH_MAX_POSITIONS);
+		int size = atoi(line + 10);
+		/* Board statics are shared, can't mix sizes. */
+		if (bench->npositions && size != board_rsize(bench->positions[0]))
+			die("%s: all positions must have the same board size\n", filename);
+		board_t *b = board_new(size, NULL);
+		b->komi = 7.5;
+		board_load(b, f, size);
+		bench->positions[bench->npositions++] = b;
+	}
+	fclose(f);
+	if (!bench->npositions)  die("%s: no positions found\n", filename);
+}
+
+int
+bench_playouts(char *filename, char *arg)
+{
+	bench_t bench = { .games = 1000, .gamelen = MAX_GAMELEN };
+	int max_threads = 1;
+	bench_load_positions(&bench, filename);
+	board_t *b = bench.positions[0];
+
+	if (arg) {
+		char *optspec, *next = arg;
+		while (*next) {
+			optspec = next;
+			next += strcspn(next, ",");
+			if (*next) { *next++ = 0; } else { *next = 0; }
+
+			char *optname = optspec;
+			char *optval = strchr(optspec, '=');
+			if (optval) *optval++ = 0;
+
+			if (!strcasecmp(optname, "games") && optval) {
+				/* Playouts per position. */
+				bench.games = atoi(optval);
+			} else if (!strcasecmp(optname, "threads") && optval) {
+				/* Run with 1, 2, 4 ... up to this many threads. */
+				max_threads = atoi(optval);
+			} else if (!strcasecmp(optname, "gamelen") && optval) {
+				bench.gamelen = atoi(optval);
+			} else if (!strcasecmp(optname, "playout") && optval) {
+				char *playoutarg = strchr(optval, ':');
+				if (playoutarg)
+					*playoutarg++ = 0;
+				if (!strcasecmp(optval, "moggy")) {
+					bench.policy = playout_moggy_init(playoutarg, b);
+				} else if (!strcasecmp(optval, "light")) {
+					bench.policy = playout_light_init(playoutarg, b);
+				} else
+					die("bench: Invalid playout policy %s\n", optval);
+			} else
+				die("bench: Invalid argument %s or missing value\n", optname);
+		}
+	}
+	if (!bench.policy)  bench.policy = playout_moggy_init(NULL, b);
+	if (max_threads < 1 || bench.games < 1)  die("bench: invalid threads / games\n");
+
+	printf("%d positions, %d playouts each\n\n", bench.npositions, bench.games);
+	printf("threads    playouts/s    avg length\n");
+	for (int threads = 1; threads <= max_threads; threads *= 2) {
+		int games;  long long moves;
+		double elapsed = bench_run(&bench, bench.policy, threads, &games, &moves);
+		printf("%7i    %10.0f    %10.1f\n", threads, games / elapsed, (double)moves / games);
+
+		if (threads < max_threads && threads * 2 > max_threads)
+			threads = max_threads / 2;
+	}
+
+	bench_phases(&bench);
+
+	playout_policy_done(bench.policy);
+	for (int i = 0; i < bench.npositions; i++)
+		board_delete(&bench.positions[i]);
+	return 0;
+}
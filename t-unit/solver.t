@@ -0,0 +1,44 @@
+% Solver: all groups pass-alive, black wins by 1.5
+boardsize 9
+X X X X X O O O O
+X . X X X O O . O
+X X X . X O O O O
+X X X X X O O O O
+X . X X X O O . O
+X X X X X O O O O
+X X X . X O O O O
+X . X X X O O . O
+X X X X X O O O O
+
+solver b b
+
+
+% Solver: white stone is dead but black's territory has inner points,
+% can't prove it without dead stones estimates.
+boardsize 9
+X X X X X O O O O
+X . . . X O O . O
+X . . . X O O O O
+X . O . X O O O O
+X . . . X O O . O
+X X X X X O O O O
+X X X . X O O O O
+X . X X X O O . O
+X X X X X O O O O
+
+solver b -
+
+
+% Solver: white stone dead in black's pass-alive area
+boardsize 9
+X X X X X O O O O
+X X X X X O O . O
+X . . . X O O O O
+X . O . X O O O O
+X . . . X O O . O
+X X X X X O O O O
+X X X . X O O O O
+X . X X X O O . O
+X X X X X O O O O
+
+solver b b
@@ -0,0 +1,71 @@
+#define DEBUG
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "board.h"
+#include "debug.h"
+#include "stats.h"
+#include "timeinfo.h"
+
+/* Microbenchmark for move_stats_t updates: all threads backpropagate
+ * results along the same path, as tree search threads do near the root.
+ * Reports updates/s for 1, 2, 4 ... threads and how many playouts got
+ * lost because of concurrent updates. Build with and without ATOMIC_STATS
+ * to compare implementations. */
+
+#define PATH_LEN     20
+#define UPDATES   200000  /* per thread, per path node */
+
+static move_stats_t path[PATH_LEN];
+
+static void *
+stats_bench_worker(void *arg)
+{
+	int seed = (int)(intptr_t)arg;
+	for (int i = 0; i < UPDATES; i++) {
+		floating_t result = ((seed + i) & 1);
+		for (int k = 0; k < PATH_LEN; k++)
+			stats_add_result(&path[k], result, 1);
+	}
+	return NULL;
+}
+
+bool
+stats_benchmark(board_t *b, char *arg)
+{
+	int max_threads = (*arg ? atoi(arg) : 64);
+	if (max_threads < 1)  die("stats_bench: invalid number of threads: %s\n", arg);
+
+#ifdef ATOMIC_STATS
+	printf("move_stats_t updates, ATOMIC_STATS (64-bit compare-and-swap)\n");
+#else
+	printf("move_stats_t updates, two stores and memory barriers\n");
+#endif
+	printf("threads    Mupdates/s    lost playouts\n");
+
+	for (int threads = 1; threads <= max_threads; threads *= 2) {
+		memset(path, 0, sizeof(path));
+		pthread_t ids[threads];
+
+		double start = time_now();
+		for (int i = 0; i < threads; i++)
+			pthread_create(&ids[i], NULL, stats_bench_worker, (void*)(intptr_t)i);
+		for (int i = 0; i < threads; i++)
+			pthread_join(ids[i], NULL);
+		double elapsed = time_now() - start;
+
+		long long expected = (long long)threads * UPDATES * PATH_LEN;
+		long long playouts = 0;
+		for (int k = 0; k < PATH_LEN; k++)
+			playouts += path[k].playouts;
+		printf("%7i    %10.1f    %6.2f%%\n", threads, expected / elapsed / 1e6,
+		       (expected - playouts) * 100.0 / expected);
+
+		if (threads < max_threads && threads * 2 > max_threads)
+			threads = max_threads / 2;
+	}
+	return true;
+}
@@ -91,7 +91,7 @@ set_handicap(board_t *b, char *arg)
 	b->handicap = atoi(arg);
 }
 
-static void
+void
 board_load(board_t *b, FILE *f, int size)
 {
 	move_t last_move = move(pass, S_NONE);
@@ -560,6 +560,58 @@ bool board_undo_stress_test(board_t *orig, char *arg);
 bool board_regression_test(board_t *orig, char *arg);
 bool moggy_regression_test(board_t *orig, char *arg);
 bool spatial_regression_test(board_t *orig, char *arg);
+bool stats_benchmark(board_t *b, char *arg);
+bool tree_benchmark(board_t *b, char *arg);
+bool tree_alloc_check(char *arg, int *odd);
+enum stone tree_solver_check(board_t *b, enum stone color, int games, char *arg, int *playouts);
+
+/* Tree nodes stay aligned with progressive widening, see tree_bench.c
+ *
+ * Syntax:  tree_alloc [uct args]
+ */
+static bool
+test_tree_alloc(board_t *b, char *arg)
+{
+	PRINT_TEST(b, "tree_alloc %s...\t", arg);
+
+	int odd;
+	bool aligned = tree_alloc_check(arg, &odd);
+	/* Make sure we tested what we want. */
+	bool passed = aligned && odd > 0;
+
+	PRINT_RES(passed);
+	return   passed;
+}
+
+/* MCTS solver: search position with @color to play, other color just
+ * passed. Check root proven winner (b, w, or - if nothing proven).
+ * A proven win must stop the search early.
+ *
+ * Syntax:  solver <color> <winner> [uct args]
+ */
+static bool
+test_solver(board_t *b, char *arg)
+{
+	int games = 20000;
+	next_arg(arg);
+	enum stone color = str2stone(arg);
+	next_arg(arg);
+	enum stone ewinner = (*arg == '-' ? S_NONE : str2stone(arg));
+	assert(color == S_BLACK || color == S_WHITE);
+
+	PRINT_TEST(b, "solver %s %s %s...\t", stone2str(color), (ewinner ? stone2str(ewinner) : "-"), next);
+
+	int playouts;
+	enum stone winner = tree_solver_check(b, color, games, next, &playouts);
+	bool passed = (winner == ewinner);
+	if (winner == color && playouts >= games / 10)
+		passed = false;		/* Search didn't stop */
+	if (DEBUGL(2))  fprintf(stderr, "proven winner: %s, %i playouts\n",
+				(winner ? stone2str(winner) : "-"), playouts);
+
+	PRINT_RES(passed);
+	return   passed;
+}
 
 typedef bool (*t_unit_func)(board_t *board, char *arg);
 
@@ -582,6 +634,10 @@ static t_unit_cmd commands[] = {
 	{ "moggy status",           test_moggy_status,      0 },
 	{ "corner_seki",            test_corner_seki,       1 },
 	{ "false_eye_seki",         test_false_eye_seki,    1 },
+	{ "stats_bench",            stats_benchmark,        0 },
+	{ "tree_bench",             tree_benchmark,         0 },
+	{ "tree_alloc",             test_tree_alloc,        0 },
+	{ "solver",                 test_solver,            1 },
 #ifdef BOARD_TESTS
 	{ "board_undo_stress_test", board_undo_stress_test, 0 },
 	{ "board_regtest",          board_regression_test,  0 },
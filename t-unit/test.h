@@ -7,4 +7,10 @@ int unit_test_cmd(struct board *b, char *line);
 /* run all unit tests in file */
 int unit_test(char *filename);
 
+/* load board diagram following 'boardsize' line */
+void board_load(struct board *b, FILE *f, int size);
+
+/* playout benchmark on positions in file, see playout_bench.c */
+int bench_playouts(char *filename, char *arg);
+
 #endif
@@ -34,16 +34,19 @@ board_quick_cmp(struct board *b1, struct board *b2)
 		return 1;
 	}
 
-	if (memcmp(b1->b,  b2->b,  sizeof(b1->b))) {
+	/* Only the part of goban maps in use, see board_copy() */
+#define map_size(field)  (board_max_coords(b1) * sizeof(b1->field[0]))
+	if (memcmp(b1->b,  b2->b,  map_size(b))) {
 		fprintf(stderr, "differs in b\n");  return 1;  }
-	if (memcmp(b1->g,  b2->g,  sizeof(b1->g))) {
+	if (memcmp(b1->g,  b2->g,  map_size(g))) {
 		fprintf(stderr, "differs in g\n");  return 1;  }
-	if (memcmp(b1->n,  b2->n,  sizeof(b1->n))) {
+	if (memcmp(b1->n,  b2->n,  map_size(n))) {
 		fprintf(stderr, "differs in n\n");  return 1;  }
-	if (memcmp(b1->p,  b2->p,  sizeof(b1->p))) {
+	if (memcmp(b1->p,  b2->p,  map_size(p))) {
 		fprintf(stderr, "differs in p\n");  return 1;  }
-	if (memcmp(b1->gi, b2->gi, sizeof(b1->gi))) {
+	if (memcmp(b1->gi, b2->gi, map_size(gi))) {
 		fprintf(stderr, "differs in gi\n");  return 1;  }
+#undef map_size
 
 	return 0;
 }
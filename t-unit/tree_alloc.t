@@ -0,0 +1,3 @@
+% Tree nodes stay aligned with progressive widening
+tree_alloc
+tree_alloc fast_alloc=0
@@ -0,0 +1,178 @@
+#define DEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "board.h"
+#include "debug.h"
+#include "engine.h"
+#include "timeinfo.h"
+#include "uct/internal.h"
+#include "uct/tree.h"
+
+/* Tree descent benchmark, with and without huge pages:
+ *
+ *   tunit tree_bench [playouts [uct args]]
+ *
+ * Runs a single threaded search on an empty 19x19 board for each
+ * huge_pages mode. Playouts are cut short (gamelen) and every visited
+ * leaf gets expanded, so time goes into tree descent and updates over
+ * a tree much bigger than what the TLB covers. Modes are run in turn
+ * a few times so that they see similar machine state, best run for
+ * each mode is reported. Pages actually obtained are logged at debug
+ * level 1. */
+
+#define TREE_BENCH_ROUNDS 3
+
+static double
+tree_bench_run(int playouts, char *mode, char *extra)
+{
+	board_t *b = board_new(19, NULL);
+	b->komi = 7.5;
+
+	char args[512];
+	snprintf(args, sizeof(args), "threads=1,expand_p=1,gamelen=30,max_tree_size=4096,huge_pages=%s%s%s",
+		 mode, (*extra ? "," : ""), extra);
+	engine_t e;
+	engine_init(&e, E_UCT, args, b);
+
+	time_info_t ti;
+	ti.period = TT_MOVE;
+	ti.dim = TD_GAMES;
+	ti.len.games = playouts;
+	ti.len.games_max = 0;
+
+	double start = time_now();
+	e.genmove(&e, b, &ti, S_BLACK, false);
+	double elapsed = time_now() - start;
+
+	engine_done(&e);
+	board_delete(&b);
+	return elapsed;
+}
+
+bool
+tree_benchmark(board_t *board, char *arg)
+{
+	int playouts = 200000;
+	char *extra = "";
+	if (*arg) {
+		playouts = atoi(arg);
+		extra = arg + strcspn(arg, " \t");
+		extra += strspn(extra, " \t");
+	}
+	if (playouts < 1)  die("tree_bench: invalid number of playouts: %s\n", arg);
+
+	char *modes[] = { "0", "thp", "explicit" };
+	const int nmodes = sizeof(modes) / sizeof(*modes);
+	double best[nmodes];
+	for (int i = 0; i < nmodes; i++)
+		best[i] = 0;
+
+	for (int round = 0; round < TREE_BENCH_ROUNDS; round++)
+		for (int i = 0; i < nmodes; i++) {
+			double elapsed = tree_bench_run(playouts, modes[i], extra);
+			if (DEBUGL(2))  fprintf(stderr, "round %i: huge_pages=%s %.0f playouts/s\n",
+						round + 1, modes[i], playouts / elapsed);
+			if (!best[i] || elapsed < best[i])
+				best[i] = elapsed;
+		}
+
+	printf("huge_pages    playouts/s  (best of %i)\n", TREE_BENCH_ROUNDS);
+	for (int i = 0; i < nmodes; i++)
+		printf("%10s    %10.0f\n", modes[i], playouts / best[i]);
+	return true;
+}
+
+/* Check alignment of nodes and stats in n's subtree, count nodes
+ * with an odd number of pending moves in *odd. */
+static bool
+tree_check_aligned(tree_node_t *n, int *odd)
+{
+	if ((uintptr_t)n % __alignof__(tree_node_t) ||
+	    (uintptr_t)tree_node_stats(n) % __alignof__(move_stats_t))
+		return false;
+	if (tree_node_has_pending(n) && tree_node_pending(n)->count % 2)
+		(*odd)++;
+	for (tree_node_t *ni = n->children; ni; ni = ni->sibling)
+		if (!tree_check_aligned(ni, odd))
+			return false;
+	return true;
+}
+
+/* Tree nodes must stay aligned with progressive widening: a block of
+ * children followed by an odd number of pending moves used to shift
+ * all blocks allocated after it.
+ *
+ *   tunit tree_alloc [uct args]
+ *
+ * Searches an empty 19x19 board, then checks every node of the tree. */
+bool
+tree_alloc_check(char *arg, int *odd)
+{
+	board_t *b = board_new(19, NULL);
+	b->komi = 7.5;
+
+	char args[512];
+	snprintf(args, sizeof(args), "threads=1,widening=5,expand_p=1,gamelen=30,resign_threshold=0,max_tree_size=256%s%s",
+		 (*arg ? "," : ""), arg);
+	engine_t e;
+	engine_init(&e, E_UCT, args, b);
+
+	time_info_t ti;
+	ti.period = TT_MOVE;
+	ti.dim = TD_GAMES;
+	ti.len.games = 2000;
+	ti.len.games_max = 0;
+	e.genmove(&e, b, &ti, S_BLACK, false);
+
+	uct_t *u = (uct_t *)e.data;
+	*odd = 0;
+	bool aligned = u->t && tree_check_aligned(u->t->root, odd);
+
+	engine_done(&e);
+	board_delete(&b);
+	return aligned;
+}
+
+/* MCTS solver: search @b with @color to play right after the other
+ * color passed, so passing ends the game.
+ *
+ *   tunit solver <color> <winner> [uct args]
+ *
+ * Returns proven winner at root (S_NONE if not proven), root playouts
+ * in *playouts. */
+enum stone
+tree_solver_check(board_t *b, enum stone color, int games, char *arg, int *playouts)
+{
+	board_t b2;
+	board_copy(&b2, b);
+	move_t m = move(pass, stone_other(color));
+	board_play(&b2, &m);
+
+	char args[512];
+	snprintf(args, sizeof(args), "threads=1,solver=1,resign_threshold=0%s%s",
+		 (*arg ? "," : ""), arg);
+	engine_t e;
+	engine_init(&e, E_UCT, args, &b2);
+
+	time_info_t ti;
+	ti.period = TT_MOVE;
+	ti.dim = TD_GAMES;
+	ti.len.games = games;
+	ti.len.games_max = 0;
+
+	/* Not genmove: it throws the tree away if we pass. */
+	uct_t *u = (uct_t *)e.data;
+	uct_genmove_setup(u, &b2, color);
+	uct_search(u, &b2, &ti, color, u->t, false);
+	tree_node_t *root = u->t->root;
+	*playouts = node_u(root).playouts;
+	enum stone winner = (root->proven == PROVEN_BLACK ? S_BLACK :
+			     root->proven == PROVEN_WHITE ? S_WHITE : S_NONE);
+
+	engine_done(&e);
+	board_done(&b2);
+	return winner;
+}
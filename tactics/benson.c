@@ -0,0 +1,166 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEBUG
+#include "board.h"
+#include "debug.h"
+#include "mq.h"
+#include "tactics/benson.h"
+
+
+/* Regions are maximal connected areas of points not of @color, they
+ * are bordered only by @color groups (or the edge). A region is vital
+ * to a group if all its empty points are liberties of the group. Groups
+ * with less than 2 vital regions can be captured, regions bordered by
+ * such groups can't be counted on: drop them and repeat until nothing
+ * changes, remaining groups are pass-alive. */
+
+static bool
+region_vital(board_t *b, coord_t *points, int n, group_t g)
+{
+	for (int i = 0; i < n; i++) {
+		coord_t p = points[i];
+		if (board_at(b, p) != S_NONE)  continue;
+		bool lib = false;
+		foreach_neighbor(b, p, {
+			if (group_at(b, c) == g)  lib = true;
+		});
+		if (!lib)  return false;
+	}
+	return true;
+}
+
+void
+benson_area(board_t *b, enum stone color, enum stone *area)
+{
+	int size = board_max_coords(b);
+	int region[size];
+	coord_t points[size];		/* Points by region */
+	int start[size + 1];		/* Region r is points[start[r]] .. points[start[r+1] - 1] */
+	bool alive[size];		/* Indexed by group */
+	int vital[size];
+	int nregions = 0, npoints = 0;
+
+	foreach_point(b) {
+		region[c] = -1;
+		alive[c] = (group_at(b, c) == c && board_at(b, c) == color);
+	} foreach_point_end;
+
+	/* Flood fill regions. */
+	foreach_point(b) {
+		if (board_at(b, c) == S_OFFBOARD || board_at(b, c) == color || region[c] >= 0)
+			continue;
+		int r = nregions++;
+		start[r] = npoints;
+		region[c] = r;
+		points[npoints++] = c;
+		for (int i = start[r]; i < npoints; i++)
+			foreach_neighbor(b, points[i], {
+				if (board_at(b, c) == S_OFFBOARD || board_at(b, c) == color || region[c] >= 0)
+					continue;
+				region[c] = r;
+				points[npoints++] = c;
+			});
+	} foreach_point_end;
+	start[nregions] = npoints;
+
+	bool region_ok[nregions ? nregions : 1];
+	for (int r = 0; r < nregions; r++)
+		region_ok[r] = true;
+
+	for (bool changed = true; changed; ) {
+		changed = false;
+
+		/* Count vital regions of each group. */
+		foreach_point(b) {
+			vital[c] = 0;
+		} foreach_point_end;
+		for (int r = 0; r < nregions; r++) {
+			if (!region_ok[r])  continue;
+			coord_t *rp = &points[start[r]];
+			int n = start[r + 1] - start[r];
+			group_t border[size];
+			int nborder = 0;
+			for (int i = 0; i < n; i++)
+				foreach_neighbor(b, rp[i], {
+					if (board_at(b, c) != color)  continue;
+					group_t g = group_at(b, c);
+					int j;
+					for (j = 0; j < nborder; j++)
+						if (border[j] == g)  break;
+					if (j == nborder)  border[nborder++] = g;
+				});
+			for (int j = 0; j < nborder; j++)
+				if (region_vital(b, rp, n, border[j]))
+					vital[border[j]]++;
+		}
+
+		foreach_point(b) {
+			if (alive[c] && vital[c] < 2) {
+				alive[c] = false;
+				changed = true;
+			}
+		} foreach_point_end;
+
+		/* Drop regions bordered by dead groups. */
+		for (int r = 0; r < nregions; r++) {
+			if (!region_ok[r])  continue;
+			for (int i = start[r]; i < start[r + 1] && region_ok[r]; i++)
+				foreach_neighbor(b, points[i], {
+					if (board_at(b, c) == color && !alive[group_at(b, c)]) {
+						region_ok[r] = false;
+						changed = true;
+					}
+				});
+		}
+	}
+
+	foreach_point(b) {
+		if (board_at(b, c) == color && alive[group_at(b, c)])
+			area[c] = color;
+	} foreach_point_end;
+
+	/* Regions where every empty point is a liberty of a pass-alive group. */
+	for (int r = 0; r < nregions; r++) {
+		if (!region_ok[r])  continue;
+		bool eyespace = false;
+		for (int i = start[r]; i < start[r + 1]; i++) {
+			coord_t p = points[i];
+			if (board_at(b, p) != S_NONE)  continue;
+			bool lib = false;
+			foreach_neighbor(b, p, {
+				if (board_at(b, c) == color)  lib = true;
+			});
+			if (!lib)  {  eyespace = true;  break;  }
+		}
+		if (eyespace)  continue;
+		for (int i = start[r]; i < start[r + 1]; i++)
+			area[points[i]] = color;
+	}
+}
+
+bool
+benson_final_score(board_t *b, floating_t *score)
+{
+	enum stone area[board_max_coords(b)];
+	foreach_point(b) {
+		area[c] = S_NONE;
+	} foreach_point_end;
+	benson_area(b, S_BLACK, area);
+	benson_area(b, S_WHITE, area);
+
+	move_queue_t dead;
+	mq_init(&dead);
+	foreach_point(b) {
+		group_t g = group_at(b, c);
+		if (!g)  continue;
+		if (area[c] == S_NONE)  return false;		/* Status unknown */
+		if (g == c && area[c] != board_at(b, c))
+			mq_add(&dead, g, 0);
+	} foreach_point_end;
+
+	*score = board_official_score(b, &dead);
+	return true;
+}
@@ -0,0 +1,21 @@
+#ifndef PACHI_TACTICS_BENSON_H
+#define PACHI_TACTICS_BENSON_H
+
+/* Unconditional life (Benson's algorithm). */
+
+#include "board.h"
+
+/* Find pass-alive groups of @color: groups which can't be captured even
+ * if @color keeps passing. Sets area[c] to @color for their stones and
+ * for regions they enclose where the opponent can't make an eye (every
+ * empty point is a liberty of a pass-alive group). Opponent stones in
+ * these regions are dead. Other points are left untouched. */
+void benson_area(board_t *b, enum stone color, enum stone *area);
+
+/* Score position at game end if it doesn't depend on dead stones
+ * estimates: every stone on the board must be either pass-alive or in
+ * opponent's pass-alive area. Score is board_official_score()'s
+ * (positive: white wins). Returns false otherwise. */
+bool benson_final_score(board_t *b, floating_t *score);
+
+#endif
@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define QUICK_BOARD_CODE
 
@@ -203,6 +204,71 @@ middle_ladder_walk(board_t *b, group_t laddered, enum stone lcolor, coord_t prev
 
 static __thread int length = 0;
 
+
+/* Ladder cache: the same ladders get read over and over, by pattern
+ * matching for every candidate move, priors and playout policy. Results
+ * of the expensive reading are kept in a small per-thread direct-mapped
+ * table, keyed on a hash of the whole position (stones, ko, last move:
+ * all ladder reading looks at) and the query. Any move changes the key
+ * so there's nothing to invalidate, quick_play()/undo() included. */
+
+#define LADDER_CACHE_BITS 10
+
+enum ladder_query {
+	LADDER_MIDDLE = 1,	/* middle_ladder_walk(laddered) */
+	LADDER_WOULDBE,		/* wouldbe_ladder_any(group, chaselib) */
+};
+
+typedef struct {
+	hash_t key;
+	int    length;		/* 0: no ladder */
+} ladder_cache_t;
+
+static __thread ladder_cache_t ladder_cache[1 << LADDER_CACHE_BITS];
+
+static hash_t
+ladder_cache_key(board_t *b, enum ladder_query query, group_t g, coord_t lib)
+{
+	/* Hash raw stones map 8 bytes at a time, much cheaper than zobrist
+	 * keys for each stone. */
+	int n = board_max_coords(b);
+	hash_t h = 0x9e3779b97f4a7c15ULL;
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		uint64_t w;  memcpy(&w, &b->b[i], 8);
+		h = (h ^ w) * 0xff51afd7ed558ccdULL;
+		h ^= h >> 32;
+	}
+	for (; i < n; i++)
+		h = (h ^ b->b[i]) * 0x100000001b3ULL;
+
+	h ^= ((hash_t)(uint16_t)b->ko.coord << 48) | ((hash_t)b->ko.color << 40);
+	h ^= ((hash_t)(uint16_t)last_move(b).coord << 24) | ((hash_t)(uint16_t)g << 8) | query;
+	h = (h ^ (hash_t)(uint16_t)lib) * 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 29;
+	return (h ? h : 1);
+}
+
+#define ladder_cache_entry(key)  (&ladder_cache[(key) & ((1 << LADDER_CACHE_BITS) - 1)])
+
+/* Don't hide reading from debugging output. */
+#define ladder_cache_enabled()  (!DEBUGL(5))
+
+static int
+middle_ladder_walk_cached(board_t *b, group_t laddered, enum stone lcolor)
+{
+	if (!ladder_cache_enabled())
+		return middle_ladder_walk(b, laddered, lcolor, pass, 0);
+
+	hash_t key = ladder_cache_key(b, LADDER_MIDDLE, laddered, pass);
+	ladder_cache_t *e = ladder_cache_entry(key);
+	if (e->key != key) {
+		e->length = middle_ladder_walk(b, laddered, lcolor, pass, 0);
+		e->key = key;
+	}
+	return e->length;
+}
+
 bool
 is_middle_ladder(board_t *b, group_t laddered)
 {
@@ -219,7 +285,7 @@ is_middle_ladder(board_t *b, group_t laddered)
 	/* A fair chance for a ladder. Group in atari, with some but limited
 	 * space to escape. Time for the expensive stuff - play it out and
 	 * start selective 2-liberty search. */
-	length = middle_ladder_walk(b, laddered, lcolor, pass, 0);
+	length = middle_ladder_walk_cached(b, laddered, lcolor);
 
 	if (DEBUGL(6) && length)  fprintf(stderr, "is_ladder(): stones: %i  length: %i\n",
 					  group_stone_count(b, laddered, 50), length);
@@ -232,17 +298,47 @@ is_middle_ladder_any(board_t *b, group_t laddered)
 {
 	enum stone lcolor = board_at(b, group_base(laddered));
 	
-	length = middle_ladder_walk(b, laddered, lcolor, pass, 0);
+	length = middle_ladder_walk_cached(b, laddered, lcolor);
 	return (length != 0);
 }
 
+/* wouldbe_ladder() / wouldbe_ladder_any() reading, once they agree. */
+static bool
+wouldbe_ladder_read(board_t *b, group_t group, coord_t chaselib)
+{
+	enum stone other_color = stone_other(board_at(b, group_base(group)));
+
+	hash_t key = 0;
+	ladder_cache_t *e = NULL;
+	if (ladder_cache_enabled()) {
+		key = ladder_cache_key(b, LADDER_WOULDBE, group, chaselib);
+		e = ladder_cache_entry(key);
+		if (e->key == key)
+			return e->length;
+	}
+
+	// FIXME should assert instead here
+	// See ~/src/pachi_bugs/silly_misread3 for example that breaks it
+	bool ladder = false;
+	if (board_is_valid_play(b, other_color, chaselib) &&
+	    !is_selfatari(b, other_color, chaselib))   // can_play_on_lib() sortof
+		with_move(b, chaselib, other_color, {
+			ladder = is_ladder_any(b, group, true);
+		});
+
+	if (e) {
+		e->key = key;
+		e->length = ladder;
+	}
+	return ladder;
+}
+
 bool
 wouldbe_ladder(board_t *b, group_t group, coord_t chaselib)
 {
 	assert(board_group_info(b, group).libs == 2);
 	
 	enum stone lcolor = board_at(b, group_base(group));
-	enum stone other_color = stone_other(lcolor);
 	coord_t escapelib = board_group_other_lib(b, group, chaselib);
 
 	if (DEBUGL(6))  fprintf(stderr, "would-be ladder check - does %s %s play out chasing move %s?\n",
@@ -253,18 +349,7 @@ wouldbe_ladder(board_t *b, group_t group, coord_t chaselib)
 		return false;
 	}
 
-	// FIXME should assert instead here
-	// See ~/src/pachi_bugs/silly_misread3 for example that breaks it
-	if (!board_is_valid_play(b, other_color, chaselib) ||
-	    is_selfatari(b, other_color, chaselib) )   // !can_play_on_lib() sortof       
-		return false;
-
-	bool ladder = false;
-	with_move(b, chaselib, other_color, {
-		ladder = is_ladder_any(b, group, true);
-	});
-	
-	return ladder;
+	return wouldbe_ladder_read(b, group, chaselib);
 }
 
 
@@ -273,20 +358,7 @@ wouldbe_ladder_any(board_t *b, group_t group, coord_t chaselib)
 {
 	assert(board_group_info(b, group).libs == 2);
 	
-	enum stone lcolor = board_at(b, group_base(group));
-	enum stone other_color = stone_other(lcolor);
-
-	// FIXME should assert instead here
-	if (!board_is_valid_play(b, other_color, chaselib) ||
-	    is_selfatari(b, other_color, chaselib) )   // !can_play_on_lib() sortof       
-		return false;
-
-	bool ladder = false;
-	with_move(b, chaselib, other_color, {
-		ladder = is_ladder_any(b, group, true);
-	});
-
-	return ladder;
+	return wouldbe_ladder_read(b, group, chaselib);
 }
 
 /* Laddered group can't escape, but playing it out could still be useful.
@@ -0,0 +1,86 @@
+#!/usr/bin/env python
+#
+# Convert a caffe dcnn to the flat binary format used by Pachi's
+# builtin cpu backend (--dcnn-backend=cpu). Needs pycaffe.
+#
+# Usage: dcnn2bin.py detlef54.prototxt detlef54.trained [detlef54.bin]
+#
+# Supported layers: Input, Convolution (stride 1, same size output),
+# ReLU, Bias, Flatten, Softmax (on flattened output).
+# See dcnn_cpu.c for the file format.
+
+import struct
+import sys
+
+import numpy as np
+import caffe
+
+CONV, BIAS, SOFTMAX = 1, 2, 3
+
+def die(msg):
+    sys.stderr.write("dcnn2bin: %s\n" % msg)
+    sys.exit(1)
+
+def convert(model, weights, out):
+    net = caffe.Net(model, weights, caffe.TEST)
+    layers = []          # [type, header ints, arrays]
+    flattened = False
+
+    for name, layer in zip(net._layer_names, net.layers):
+        t = layer.type
+        if t in ("Input", "Data", "MemoryData"):
+            continue
+        elif t == "Convolution":
+            w = layer.blobs[0].data
+            out_c, in_c, kh, kw = w.shape
+            b = layer.blobs[1].data if len(layer.blobs) > 1 else np.zeros(out_c)
+            if kh != kw or kh % 2 == 0:
+                die("%s: unsupported kernel %ix%i" % (name, kh, kw))
+            # Same size convolution is all we support, check output shape.
+            top = net.blobs[net.top_names[name][0]].data.shape
+            bottom = net.blobs[net.bottom_names[name][0]].data.shape
+            if top[2:] != bottom[2:]:
+                die("%s: convolution doesn't preserve board size" % name)
+            layers.append([CONV, [in_c, out_c, kh, kh // 2, 0], [w, b]])
+        elif t == "ReLU":
+            if not layers or layers[-1][0] != CONV:
+                die("%s: relu must follow a convolution" % name)
+            layers[-1][1][4] = 1
+        elif t == "Bias":
+            # Per position bias, possibly on flattened output.
+            b = layer.blobs[0].data
+            convs = [l for l in layers if l[0] == CONV]
+            if not convs:
+                die("%s: bias must follow a convolution" % name)
+            c = convs[-1][1][1]
+            n = b.size // c
+            size = int(round(n ** 0.5))
+            if size * size * c != b.size:
+                die("%s: unsupported bias shape %s" % (name, b.shape))
+            layers.append([BIAS, [c, size, size], [b]])
+        elif t == "Flatten":
+            flattened = True
+        elif t == "Softmax":
+            if not flattened:
+                die("%s: softmax over channels not supported, only flattened output" % name)
+            layers.append([SOFTMAX, [], []])
+        else:
+            die("%s: unsupported layer type %s" % (name, t))
+
+    with open(out, "wb") as f:
+        f.write(b"PACHINN1")
+        f.write(struct.pack("i", len(layers)))
+        for type, ints, arrays in layers:
+            f.write(struct.pack("i", type))
+            for v in ints:
+                f.write(struct.pack("i", v))
+            for a in arrays:
+                f.write(np.ascontiguousarray(a, dtype=np.float32).tobytes())
+    print("%s: %i layers" % (out, len(layers)))
+
+if __name__ == "__main__":
+    if len(sys.argv) not in (3, 4):
+        die("usage: dcnn2bin.py model.prototxt weights.trained [out.bin]")
+    model, weights = sys.argv[1], sys.argv[2]
+    out = sys.argv[3] if len(sys.argv) == 4 else model.rsplit(".", 1)[0] + ".bin"
+    convert(model, weights, out)
@@ -0,0 +1,202 @@
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEBUG
+#include "board.h"
+#include "debug.h"
+#include "dcnn.h"
+#include "uct/dcnn_queue.h"
+#include "uct/internal.h"
+#include "uct/prior.h"
+#include "uct/tree.h"
+
+typedef struct {
+	tree_node_t *node;
+	int parity;		/* tree parity, as in prior_map_t */
+	dcnn_key_t key;		/* evaluation cache key */
+} dcnn_item_t;
+
+/* Pending positions, circular buffer. Input planes of item i are
+ * at data[i * input_size]. */
+typedef struct {
+	uct_t *u;
+	board_t *b;
+	int batch;
+	int capacity;
+	int input_size;
+
+	dcnn_item_t *items;
+	float *data;
+	int head, count;
+
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	volatile bool running;
+
+	/* Statistics */
+	int evaluated, batches, dropped, cached;
+} dcnn_queue_t;
+
+static dcnn_queue_t q = { .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+
+
+/* Add dcnn priors to node's children. */
+static void
+dcnn_queue_apply(uct_t *u, dcnn_item_t *item, float *r)
+{
+	tree_node_t *node = item->node;
+	floating_t value = (item->parity > 0 ? 1 : 0);
+
+	/* Progressive widening: pending moves get dcnn priors too.
+	 * Hold pending lock so no child gets created meanwhile. */
+	tree_pending_t *p = (tree_node_has_pending(node) ? tree_node_pending(node) : NULL);
+	if (p) {
+		while (__sync_lock_test_and_set(&p->lock, 1))
+			;
+		for (int i = 0; i < p->count; i++) {
+			tree_pending_move_t *m = &p->move[i];
+			float val = r[coord2dcnn_idx(m->coord)];
+			if (m->taken || isnan(val) || val < 0.001)
+				continue;
+			stats_add_result(&m->prior, value, sqrt(val) * u->prior->dcnn_eqex);
+		}
+	}
+
+	for (tree_node_t *ni = node->children; ni; ni = ni->sibling) {
+		coord_t c = node_coord(ni);
+		if (is_pass(c))
+			continue;
+		float val = r[coord2dcnn_idx(c)];
+		if (isnan(val) || val < 0.001)
+			continue;
+		assert(val >= 0.0 && val <= 1.0);
+		stats_add_result(&node_prior(ni), value, sqrt(val) * u->prior->dcnn_eqex);
+	}
+	node->hints |= TREE_HINT_DCNN;
+
+	if (p)
+		__sync_lock_release(&p->lock);
+}
+
+static void *
+dcnn_queue_worker(void *arg)
+{
+	int size = board_rsize(q.b);
+	float       *data = cmalloc(q.batch * q.input_size * sizeof(float));
+	float     *result = cmalloc(q.batch * size * size * sizeof(float));
+	dcnn_item_t items[q.batch];
+
+	pthread_mutex_lock(&q.lock);
+	while (true) {
+		while (q.running && !q.count)
+			pthread_cond_wait(&q.cond, &q.lock);
+		if (!q.running)
+			break;
+
+		/* Take up to q.batch pending positions. */
+		int n = MIN(q.count, q.batch);
+		for (int i = 0; i < n; i++) {
+			int k = (q.head + i) % q.capacity;
+			items[i] = q.items[k];
+			memcpy(&data[i * q.input_size], &q.data[k * q.input_size], q.input_size * sizeof(float));
+		}
+		q.head = (q.head + n) % q.capacity;
+		q.count -= n;
+		pthread_mutex_unlock(&q.lock);
+
+		dcnn_evaluate_batch(q.b, data, result, n);
+		for (int i = 0; i < n; i++) {
+			dcnn_cache_put(&items[i].key, &result[i * size * size]);
+			dcnn_queue_apply(q.u, &items[i], &result[i * size * size]);
+		}
+
+		pthread_mutex_lock(&q.lock);
+		q.evaluated += n;
+		q.batches++;
+	}
+	pthread_mutex_unlock(&q.lock);
+
+	free(data);
+	free(result);
+	return NULL;
+}
+
+void
+dcnn_queue_start(uct_t *u, board_t *b)
+{
+	assert(!q.running);
+	if (!u->dcnn_batch || !u->prior->dcnn_eqex || !using_dcnn(b))
+		return;
+
+	q.u = u;
+	q.b = b;
+	q.batch = u->dcnn_batch;
+	q.capacity = u->dcnn_batch * 4;
+	q.input_size = dcnn_input_size(b);
+	q.items = calloc2(q.capacity, dcnn_item_t);
+	q.data = cmalloc(q.capacity * q.input_size * sizeof(float));
+	q.head = q.count = 0;
+	q.evaluated = q.batches = q.dropped = q.cached = 0;
+
+	q.running = true;
+	pthread_create(&q.thread, NULL, dcnn_queue_worker, NULL);
+}
+
+void
+dcnn_queue_stop(void)
+{
+	if (!q.running)
+		return;
+
+	pthread_mutex_lock(&q.lock);
+	q.running = false;
+	pthread_cond_signal(&q.cond);
+	pthread_mutex_unlock(&q.lock);
+	pthread_join(q.thread, NULL);
+
+	uct_t *u = q.u;
+	if (UDEBUGL(2))
+		fprintf(stderr, "dcnn queue: %d nodes evaluated in %d batches, %d cached, %d dropped, %d pending\n",
+			q.evaluated, q.batches, q.cached, q.dropped, q.count);
+
+	free(q.items);  q.items = NULL;
+	free(q.data);   q.data = NULL;
+}
+
+void
+dcnn_queue_submit(uct_t *u, tree_t *t, tree_node_t *node, board_t *b, enum stone color, int parity)
+{
+	if (!q.running || (node->hints & TREE_HINT_DCNN))
+		return;
+
+	dcnn_item_t item = { node, tree_parity(t, parity) };
+	dcnn_cache_key(b, color, &item.key);
+	int size = board_rsize(b);
+	float r[size * size];
+	if (dcnn_cache_get(&item.key, r)) {
+		dcnn_queue_apply(u, &item, r);
+		__sync_fetch_and_add(&q.cached, 1);
+		return;
+	}
+
+	/* Build input planes outside the lock, workers do this in parallel. */
+	float data[q.input_size];
+	dcnn_get_planes(b, color, data);
+
+	pthread_mutex_lock(&q.lock);
+	if (!q.running || q.count == q.capacity) {
+		q.dropped++;
+		pthread_mutex_unlock(&q.lock);
+		return;
+	}
+	int k = (q.head + q.count++) % q.capacity;
+	q.items[k] = item;
+	memcpy(&q.data[k * q.input_size], data, q.input_size * sizeof(float));
+	pthread_cond_signal(&q.cond);
+	pthread_mutex_unlock(&q.lock);
+}
@@ -0,0 +1,36 @@
+#ifndef PACHI_UCT_DCNN_QUEUE_H
+#define PACHI_UCT_DCNN_QUEUE_H
+
+/* Batched asynchronous dcnn evaluation of tree nodes.
+ *
+ * Root priors are computed synchronously before the search starts. With
+ * the dcnn_batch uct option set, nodes expanded during the search are also
+ * dcnn evaluated: expanding threads build the input planes and queue them,
+ * a dedicated evaluator thread groups up to dcnn_batch pending positions
+ * into one forward pass. Nodes are expanded with provisional priors, dcnn
+ * priors are added to their children when the result lands and the node
+ * gets TREE_HINT_DCNN. Positions already in the dcnn evaluation cache
+ * get their priors right away. If the queue is full the node keeps
+ * provisional priors. Pending evaluations are dropped when the search stops. */
+
+#include "uct/internal.h"
+
+#ifdef DCNN
+
+/* Start / stop evaluator thread for current search. */
+void dcnn_queue_start(uct_t *u, board_t *b);
+void dcnn_queue_stop(void);
+
+/* Queue node for evaluation, if evaluator is running.
+ * Called from tree_expand_node(), once node's children are set. */
+void dcnn_queue_submit(uct_t *u, tree_t *t, tree_node_t *node, board_t *b, enum stone color, int parity);
+
+#else
+
+#define dcnn_queue_start(u, b)  ((void)0)
+#define dcnn_queue_stop()       ((void)0)
+#define dcnn_queue_submit(u, t, node, b, color, parity)  ((void)0)
+
+#endif
+
+#endif
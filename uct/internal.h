@@ -11,6 +11,7 @@
 #include "patternprob.h"
 #include "playout.h"
 #include "stats.h"
+#include "timeinfo.h"
 #include "mq.h"
 #include "uct/tree.h"
 #include "uct/prior.h"
@@ -54,6 +55,8 @@ typedef struct uct {
 	bool allow_losing_pass;
 	bool territory_scoring;
 	int expand_p;
+	int widening;
+	int widening_playouts;
 	bool playout_amaf;
 	bool amaf_prior;
 	int playout_amaf_cutoff;
@@ -64,9 +67,17 @@ typedef struct uct {
 	size_t max_tree_size;
 	size_t max_pruned_size;
 	size_t pruning_threshold;
+	bool concurrent_gc;
+	bool recycle;
+	bool pin_threads;
+	bool numa_interleave;
+	enum tree_huge_pages huge_pages;
 	int mercymin;
 	int significant_threshold;
+	bool solver;
 	bool genmove_reset_tree;
+	int tt_seed;                /* Transposition seeding table bits, 0 if disabled */
+	int tt_seed_eqex;
 
 	int threads;
 	enum uct_thread_model thread_model;
@@ -82,6 +93,7 @@ typedef struct uct {
 	int     dcnn_pondering_prior;      /* Prior next move guesses */
 	int     dcnn_pondering_mcts;       /* Genmove next move guesses */
 	coord_t dcnn_pondering_mcts_c[20];
+	int     dcnn_batch;                /* Batched dcnn evaluation of expanded nodes */
 	
 	int fuseki_end;
 	int yose_start;
@@ -144,6 +156,13 @@ typedef struct uct {
 	/* Game state - maintained by setup_state(), reset_state(). */
 	tree_t *t;
 	bool tree_ready;
+
+	/* Persistent search threads, see uct/search.c */
+	struct uct_pool *pool;
+	/* Root playouts at which workers trigger next search stop check. */
+	volatile int milestone;
+	/* Workers must park, see uct_search_pause(). */
+	volatile bool pause;
 } uct_t;
 
 #define UDEBUGL(n) DEBUGL_(u->debug_level, n)
@@ -151,6 +170,7 @@ typedef struct uct {
 bool uct_pass_is_safe(uct_t *u, board_t *b, enum stone color, bool pass_all_alive, char **msg);
 void uct_prepare_move(uct_t *u, board_t *b, enum stone color);
 void uct_genmove_setup(uct_t *u, board_t *b, enum stone color);
+int  uct_search(uct_t *u, board_t *b, time_info_t *ti, enum stone color, tree_t *t, bool print_progress);
 void uct_pondering_stop(uct_t *u);
 void uct_get_best_moves(uct_t *u, coord_t *best_c, float *best_r, int nbest, bool winrates, int min_playouts);
 void uct_get_best_moves_at(uct_t *u, tree_node_t *n, coord_t *best_c, float *best_r, int nbest, bool winrates, int min_playouts);
@@ -19,6 +19,13 @@ uctp_generic_choose(uct_policy_t *p, tree_node_t *node, board_t *b, enum stone c
 	if (!nbest) return NULL;
 	tree_node_t *nbest2 = nbest->sibling;
 
+	/* Solver: play proven win if we have one. */
+	if (p->uct->solver)
+		for (tree_node_t *ni = nbest; ni; ni = ni->sibling)
+			if (ni->proven == proven_win(color) && node_coord(ni) != exclude &&
+			    !(ni->hints & TREE_HINT_INVALID))
+				return ni;
+
 	/* This function is called while the tree is updated by other threads.
 	 * We rely on node->children being set only after the node has been fully expanded. */
 	for (tree_node_t *ni = nbest2; ni; ni = ni->sibling) {
@@ -26,10 +33,10 @@ uctp_generic_choose(uct_policy_t *p, tree_node_t *node, board_t *b, enum stone c
 		// child; comparing values is more brittle
 		if (node_coord(ni) == exclude || ni->hints & TREE_HINT_INVALID)
 			continue;
-		if (ni->u.playouts > nbest->u.playouts) {
+		if (node_u(ni).playouts > node_u(nbest).playouts) {
 			nbest2 = nbest;
 			nbest = ni;
-		} else if (ni->u.playouts > nbest2->u.playouts) {
+		} else if (node_u(ni).playouts > node_u(nbest2).playouts) {
 			nbest2 = ni;
 		}
 	}
@@ -27,14 +27,23 @@ void uctp_generic_winner(uct_policy_t *p, tree_t *tree, uct_descent_t *descent);
 	/* XXX: We assume board <=25x25. */ \
 	uct_descent_t dbest[BOARD_MAX_MOVES + 1] = { uct_descent(descent->node->children, NULL) }; int dbests = 1; \
 	floating_t best_urgency = -9999; \
-	/* Descent children iterator. */ \
+	/* Descent children iterator. Children are walked block by block as
+	 * dense arrays, dchild is the index of the current one within the
+	 * dchildren block (more than one block with progressive widening). */ \
 	uct_descent_t dci = uct_descent(descent->node->children, (descent->lnode ? descent->lnode->children : NULL)); \
+	tree_node_t *dchildren = descent->node->children; \
 	\
-	for (; dci.node; dci.node = dci.node->sibling) { \
+	for (int dchild = 0; dchildren; \
+	     dchild < dchildren->count - 1 ? dchild++ : (dchildren = tree_block_next(dchildren), dchild = 0)) { \
+		dci.node = dchildren + dchild; \
 		floating_t urgency; \
 		/* Do not consider passing early. */ \
 		if (unlikely((!allow_pass && is_pass(node_coord(dci.node))) || (dci.node->hints & TREE_HINT_INVALID))) \
 			continue; \
+		/* Never revisit proven losses (solver), unless all moves lose. */ \
+		if (unlikely(dci.node->proven && !descent->node->proven && \
+			     dci.node->proven == proven_loss(parity > 0 ? stone_other(tree->root_color) : tree->root_color))) \
+			continue; \
 		/* Position dci.lnode to point at or right after the local
 		 * node corresponding to dci.node. */ \
 		while (dci.lnode && node_coord(dci.lnode) < node_coord(dci.node)) \
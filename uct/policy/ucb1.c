@@ -36,17 +36,17 @@ ucb1_descend(uct_policy_t *p, tree_t *tree, uct_descent_t *descent, int parity,
 	 * of the explore coefficient. */
 
 	ucb1_policy_t *b = (ucb1_policy_t*)p->data;
-	floating_t xpl = log(descent->node->u.playouts + descent->node->prior.playouts);
+	floating_t xpl = log(node_u(descent->node).playouts + node_prior(descent->node).playouts);
 
 	uctd_try_node_children(tree, descent, allow_pass, parity, p->uct->tenuki_d, di, urgency) {
 		tree_node_t *ni = di.node;
-		int uct_playouts = ni->u.playouts + ni->prior.playouts + ni->descents;
+		int uct_playouts = node_u(ni).playouts + node_prior(ni).playouts + ni->descents;
 
 		/* xxx: we don't take local-tree information into account. */
 
 		if (uct_playouts) {
-			urgency = (ni->u.playouts * tree_node_get_value(tree, parity, ni->u.value)
-				   + ni->prior.playouts * tree_node_get_value(tree, parity, ni->prior.value))
+			urgency = (node_u(ni).playouts * tree_node_get_value(tree, parity, node_u(ni).value)
+				   + node_prior(ni).playouts * tree_node_get_value(tree, parity, node_prior(ni).value))
 				   + (parity > 0 ? 0 : ni->descents)
 				  / uct_playouts;
 			urgency += b->explore_p * sqrt(xpl / uct_playouts);
@@ -68,7 +68,7 @@ ucb1_update(uct_policy_t *p, tree_t *tree, tree_node_t *node, enum stone node_co
 	enum stone winner_color = result > 0.5 ? S_BLACK : S_WHITE;
 
 	for (; node; node = node->parent) {
-		stats_add_result(&node->u, result, 1);
+		stats_add_result(&node_u(node), result, 1);
 
 		if (!is_pass(node_coord(node))) {
 			stats_add_result(&node->winner_owner, board_at(final_board, node_coord(node)) == winner_color ? 1.0 : 0.0, 1);
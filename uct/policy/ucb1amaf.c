@@ -102,18 +102,21 @@ static inline floating_t fast_sqrt(unsigned int x)
 }
 
 #define URAVE_DEBUG if (0)
+/* Evaluate descent->node given its u, amaf and prior stats, which
+ * descend passes straight from the children block arrays. */
 static inline floating_t
-ucb1rave_evaluate(uct_policy_t *p, tree_t *tree, uct_descent_t *descent, int parity)
+ucb1rave_evaluate_stats(uct_policy_t *p, tree_t *tree, uct_descent_t *descent, int parity,
+			move_stats_t *nu, move_stats_t *namaf, move_stats_t *nprior)
 {
 	ucb1_policy_amaf_t *b = (ucb1_policy_amaf_t*)p->data;
 	tree_node_t *node = descent->node;
 	tree_node_t *lnode = descent->lnode;
 
-	move_stats_t n = node->u, r = node->amaf;
+	move_stats_t n = *nu, r = *namaf;
 	if (p->uct->amaf_prior) {
-		stats_merge(&r, &node->prior);
+		stats_merge(&r, nprior);
 	} else {
-		stats_merge(&n, &node->prior);
+		stats_merge(&n, nprior);
 	}
 
 	if (p->uct->virtual_loss) {
@@ -129,7 +132,7 @@ ucb1rave_evaluate(uct_policy_t *p, tree_t *tree, uct_descent_t *descent, int par
 	assert(!lnode || lnode->parent);
 	if (p->uct->local_tree && b->ltree_rave > 0 && lnode
 	    && (p->uct->local_tree_rootchoose || lnode->parent->parent)) {
-		move_stats_t l = lnode->u;
+		move_stats_t l = node_u(lnode);
 		l.playouts = ((floating_t) l.playouts) * b->ltree_rave / LTREE_PLAYOUTS_MULTIPLIER;
 		URAVE_DEBUG fprintf(stderr, "[ltree] adding [%s] %f%%%d to [%s] RAVE %f%%%d\n",
 			coord2sstr(node_coord(lnode)), l.value, l.playouts,
@@ -139,8 +142,8 @@ ucb1rave_evaluate(uct_policy_t *p, tree_t *tree, uct_descent_t *descent, int par
 
 	/* Criticality heuristics. */
 	if (b->crit_rave > 0 && (b->crit_plthres_coef > 0
-				 ? node->u.playouts > tree->root->u.playouts * b->crit_plthres_coef
-				 : node->u.playouts > b->crit_min_playouts)) {
+				 ? nu->playouts > node_u(tree->root).playouts * b->crit_plthres_coef
+				 : nu->playouts > b->crit_min_playouts)) {
 		floating_t crit = tree_node_criticality(tree, node);
 		if (b->crit_negative || crit > 0) {
 			floating_t val = 1.0f;
@@ -168,21 +171,21 @@ ucb1rave_evaluate(uct_policy_t *p, tree_t *tree, uct_descent_t *descent, int par
 					+ (floating_t) n.playouts * r.playouts / b->equiv_rave);
 			} else {
 				/* XXX: This can be cached in descend; but we don't use this by default. */
-				beta = sqrt(b->equiv_rave / (3 * node->parent->u.playouts + b->equiv_rave));
+				beta = sqrt(b->equiv_rave / (3 * node_u(node->parent).playouts + b->equiv_rave));
 			}
 
 			value = beta * r.value + (1.f - beta) * n.value;
 			URAVE_DEBUG fprintf(stderr, "\t%s value = %f * %f + (1 - %f) * %f (prior %f)\n",
-			        coord2sstr(node_coord(node)), beta, r.value, beta, n.value, node->prior.value);
+			        coord2sstr(node_coord(node)), beta, r.value, beta, n.value, nprior->value);
 		} else {
 			value = n.value;
 			URAVE_DEBUG fprintf(stderr, "\t%s value = %f (prior %f)\n",
-			        coord2sstr(node_coord(node)), n.value, node->prior.value);
+			        coord2sstr(node_coord(node)), n.value, nprior->value);
 		}
 	} else if (r.playouts) {
 		value = r.value;
 		URAVE_DEBUG fprintf(stderr, "\t%s value = rave %f (prior %f)\n",
-			coord2sstr(node_coord(node)), r.value, node->prior.value);
+			coord2sstr(node_coord(node)), r.value, nprior->value);
 	}
 	descent->value.playouts = r.playouts + n.playouts;
 	descent->value.value = value;
@@ -190,13 +193,21 @@ ucb1rave_evaluate(uct_policy_t *p, tree_t *tree, uct_descent_t *descent, int par
 	return tree_node_get_value(tree, parity, value);
 }
 
+static floating_t
+ucb1rave_evaluate(uct_policy_t *p, tree_t *tree, uct_descent_t *descent, int parity)
+{
+	tree_node_t *node = descent->node;
+	return ucb1rave_evaluate_stats(p, tree, descent, parity,
+				       &node_u(node), &node_amaf(node), &node_prior(node));
+}
+
 void
 ucb1rave_descend(uct_policy_t *p, tree_t *tree, uct_descent_t *descent, int parity, bool allow_pass)
 {
 	ucb1_policy_amaf_t *b = (ucb1_policy_amaf_t*)p->data;
 	floating_t nconf = 1.f;
 	if (b->explore_p > 0)
-		nconf = sqrt(log(descent->node->u.playouts + descent->node->prior.playouts));
+		nconf = sqrt(log(node_u(descent->node).playouts + node_prior(descent->node).playouts));
 	uct_t *u = p->uct;
 #ifdef DISTRIBUTED
 	int vwin = 0;
@@ -204,23 +215,25 @@ ucb1rave_descend(uct_policy_t *p, tree_t *tree, uct_descent_t *descent, int pari
 		vwin = descent->node == tree->root ? b->root_virtual_win : b->virtual_win;
 	int child = 0;
 #endif
-
 	uctd_try_node_children(tree, descent, allow_pass, parity, u->tenuki_d, di, urgency) {
-		tree_node_t *ni = di.node;
-		urgency = ucb1rave_evaluate(p, tree, &di, parity);
+		/* Children stats, walked as dense arrays. */
+		move_stats_t *nu = &tree_block_u(dchildren)[dchild];
+		move_stats_t *namaf = &tree_block_amaf(dchildren)[dchild];
+		move_stats_t *nprior = &tree_block_prior(dchildren)[dchild];
+		urgency = ucb1rave_evaluate_stats(p, tree, &di, parity, nu, namaf, nprior);
 
 #ifdef DISTRIBUTED
 		/* In distributed mode, encourage different slaves to work on different
 		 * parts of the tree. We rely on the fact that children (if they exist)
 		 * are the same and in the same order in all slaves. */
-		if (vwin > 0 && ni->u.playouts > b->vwin_min_playouts && (child - u->slave_index) % u->max_slaves == 0)
-			urgency += vwin / (ni->u.playouts + vwin);
+		if (vwin > 0 && nu->playouts > b->vwin_min_playouts && (child - u->slave_index) % u->max_slaves == 0)
+			urgency += vwin / (nu->playouts + vwin);
 #endif
 
-		if (ni->u.playouts > 0 && b->explore_p > 0) {
-			urgency += b->explore_p * nconf / fast_sqrt(ni->u.playouts);
+		if (nu->playouts > 0 && b->explore_p > 0) {
+			urgency += b->explore_p * nconf / fast_sqrt(nu->playouts);
 
-		} else if (ni->u.playouts + ni->amaf.playouts + ni->prior.playouts == 0) {
+		} else if (nu->playouts + namaf->playouts + nprior->playouts == 0) {
 			/* assert(!u->even_eqex); */
 			urgency = b->fpu;
 		}
@@ -246,6 +259,18 @@ static inline int ko_length(bool *ko_capture_map, int map_length)
 	return length;
 }
 
+/* Record @c as first played at index @move (moves are scanned backwards). */
+static inline void
+first_move_set(int *first_move, uint64_t first_play[2][BOARD_MAX_COORDS / 64 + 1], coord_t c, int move)
+{
+	first_move[c] = move;
+	if (is_pass(c))
+		return;
+	uint64_t bit = 1ULL << (c & 63);
+	first_play[move & 1][c >> 6] |= bit;
+	first_play[!(move & 1)][c >> 6] &= ~bit;
+}
+
 void
 ucb1amaf_update(uct_policy_t *p, tree_t *tree, tree_node_t *node,
 		enum stone node_color, enum stone player_color,
@@ -257,11 +282,15 @@ ucb1amaf_update(uct_policy_t *p, tree_t *tree, tree_node_t *node,
 
 	/* Record of the random playout - for each intersection coord,
 	 * first_move[coord] is the index map->game of the first move
-	 * at this coordinate, or INT_MAX if the move was not played.
-	 * The parity gives the color of this move.
+	 * at this coordinate. The parity gives the color of this move.
+	 * first_play[parity] is a bitmap of coords first played at a move
+	 * index of that parity: first_move[] is valid only if the coord is
+	 * in one of them, so only played moves need to be initialized and
+	 * children are filtered with a single bit test at each level.
 	 */
 	int first_map[board_max_coords(final_board)+1];
 	int *first_move = &first_map[1]; // +1 for pass
+	uint64_t first_play[2][BOARD_MAX_COORDS / 64 + 1];
 
 #if 0
 	board_t bb; bb.size = 9+2;
@@ -272,34 +301,39 @@ ucb1amaf_update(uct_policy_t *p, tree_t *tree, tree_node_t *node,
 #endif
 
 	/* Initialize first_move */
-	for (int i = pass; i < board_max_coords(final_board); i++) first_move[i] = INT_MAX;
+	memset(first_play, 0, sizeof(first_play));
 	int move;
 	assert(map->gamelen > 0);
 	for (move = map->gamelen - 1; move >= map->game_baselen; move--)
-		first_move[map->game[move]] = move;
+		first_move_set(first_move, first_play, map->game[move], move);
 
 	while (node) {
 		if (!b->crit_amaf && !is_pass(node_coord(node))) {
 			stats_add_result(&node->winner_owner, board_local_value(b->crit_lvalue, final_board, node_coord(node), winner_color), 1);
 			stats_add_result(&node->black_owner, board_local_value(b->crit_lvalue, final_board, node_coord(node), S_BLACK), 1);
 		}
-		stats_add_result(&node->u, result, 1);
+		stats_add_result(&node_u(node), result, 1);
 
 		bool *ko_capture_map = &map->is_ko_capture[move+1];
 		int max_threat_dist = b->threat_rave <= 0 ? ko_length(ko_capture_map, map->gamelen - (move+1)) : -1;
 
+		/* Children moves first played by the same color, i.e. at an
+		 * even distance from the next move. */
+		uint64_t *mask = first_play[(move + 1) & 1];
+
 		/* This loop ignores symmetry considerations, but they should
 		 * matter only at a point when AMAF doesn't help much. */
 		assert(map->game_baselen >= 0);
-		for (tree_node_t *ni = node->children; ni; ni = ni->sibling) {
-			if (is_pass(node_coord(ni))) continue;
-
-			/* Use the child move only if it was first played by the same color. */
-			int first = first_move[node_coord(ni)];
-			if (first == INT_MAX) continue;
+		tree_node_t *block = node->children;
+		for (int i = 0; block; i < block->count - 1 ? i++ : (block = tree_block_next(block), i = 0)) {
+			tree_node_t *ni = block + i;
+			coord_t c = node_coord(ni);
+			if (is_pass(c) || !(mask[c >> 6] & (1ULL << (c & 63))))
+				continue;
+
+			int first = first_move[c];
 			assert(first > move && first < map->gamelen);
 			int distance = first - (move + 1);
-			if (distance & 1) continue;
 
 			int weight = 1;
 			floating_t res = result;
@@ -314,23 +348,23 @@ ucb1amaf_update(uct_policy_t *p, tree_t *tree, tree_node_t *node,
 				/* Give more weight to moves played earlier */
 				weight += b->distance_rave * (map->gamelen - first) / (map->gamelen - move);
 			}
-			stats_add_result(&ni->amaf, res, weight);
+			stats_add_result(&tree_block_amaf(block)[i], res, weight);
 
 			if (b->crit_amaf) {
-				stats_add_result(&ni->winner_owner, board_local_value(b->crit_lvalue, final_board, node_coord(ni), winner_color), 1);
-				stats_add_result(&ni->black_owner, board_local_value(b->crit_lvalue, final_board, node_coord(ni), S_BLACK), 1);
+				stats_add_result(&ni->winner_owner, board_local_value(b->crit_lvalue, final_board, c, winner_color), 1);
+				stats_add_result(&ni->black_owner, board_local_value(b->crit_lvalue, final_board, c, S_BLACK), 1);
 			}
 #if 0
 			board_t bb; bb.size = 9+2;
-			fprintf(stderr, "* %s<%" PRIhash "> -> %s<%" PRIhash "> [%d/%f => %d/%f]\n",
-				coord2sstr(node_coord(node)), node->hash,
-				coord2sstr(node_coord(ni)), ni->hash,
+			fprintf(stderr, "* %s<%p> -> %s<%p> [%d/%f => %d/%f]\n",
+				coord2sstr(node_coord(node)), node,
+				coord2sstr(c), ni,
 				player_color, result, move, res);
 #endif
 		}
 		if (node->parent) {
-			assert(move >= 0 && map->game[move] == node_coord(node) && first_move[node_coord(node)] > move);
-			first_move[node_coord(node)] = move;
+			assert(move >= 0 && map->game[move] == node_coord(node));
+			first_move_set(first_move, first_play, node_coord(node), move);
 			move--;
 		}
 		node = node->parent;
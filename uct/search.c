@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <errno.h>
 #include <limits.h>
 #include <math.h>
 #include <pthread.h>
@@ -18,6 +19,8 @@
 #include "timeinfo.h"
 #include "tactics/1lib.h"
 #include "tactics/2lib.h"
+#include "numa.h"
+#include "uct/dcnn_queue.h"
 #include "uct/dynkomi.h"
 #include "uct/internal.h"
 #include "uct/search.h"
@@ -61,7 +64,7 @@ default_ti_init(void)
  *   |         starts and stops the search managed by thread_manager
  *   |
  * thread_manager
- *   |         spawns and collects worker threads
+ *   |         wakes up and collects worker threads
  *   |
  * worker0
  * worker1
@@ -69,6 +72,10 @@ default_ti_init(void)
  * workerK
  *             uct_playouts() loop, doing descend-playout until uct_halt
  *
+ * Worker threads are persistent: they are created once with the engine
+ * (uct_pool_init()) and sleep between searches, so starting a search
+ * (genmove, pondering) doesn't pay for thread creation.
+ *
  * Another way to look at it is by functions (lines denote thread boundaries):
  *
  * | uct_genmove()
@@ -90,6 +97,23 @@ static pthread_cond_t finish_cond = PTHREAD_COND_INITIALIZER;
 static volatile int finish_thread;
 static pthread_mutex_t finish_serializer = PTHREAD_MUTEX_INITIALIZER;
 
+/* Persistent worker threads. */
+typedef struct uct_pool {
+	int threads;
+	pthread_t *ids;
+	uct_thread_ctx_t *ctx;		/* Worker contexts, set up by thread manager for each search. */
+	pthread_mutex_t mutex;
+	pthread_cond_t start_cond;	/* New search or quit. */
+	pthread_cond_t ready_cond;	/* Root node expanded (u->tree_ready). */
+	pthread_cond_t wake_cond;	/* Search stop check needed. */
+	bool wake;
+	pthread_cond_t pause_cond;	/* Worker parked or search resumed. */
+	int active;			/* Workers in uct_playouts() */
+	int paused;			/* Workers parked in uct_worker_pause() */
+	unsigned int search;		/* Bumped to start a search. */
+	bool quit;
+} uct_pool_t;
+
 static void  uct_expand_next_best_moves(uct_t *u, tree_t *t, board_t *b, enum stone color);
 static void *spawn_logger(void *ctx_);
 
@@ -138,14 +162,27 @@ spawn_worker(void *ctx_)
 			print_joseki_moves(joseki_dict, b, color);
 			print_node_prior_best_moves(b, n);
 		}
+		pthread_mutex_lock(&u->pool->mutex);
 		u->tree_ready = true;
+		pthread_cond_broadcast(&u->pool->ready_cond);
+		pthread_mutex_unlock(&u->pool->mutex);
+	} else {
+		pthread_mutex_lock(&u->pool->mutex);
+		while (!u->tree_ready)
+			pthread_cond_wait(&u->pool->ready_cond, &u->pool->mutex);
+		pthread_mutex_unlock(&u->pool->mutex);
 	}
-	else while (!u->tree_ready)
-		     usleep(100 * 1000);
 
 	/* Run */
 	if (!ctx->tid)  u->mcts_time_start = time_now();
+	pthread_mutex_lock(&u->pool->mutex);
+	u->pool->active++;
+	pthread_mutex_unlock(&u->pool->mutex);
 	ctx->games = uct_playouts(ctx->u, ctx->b, ctx->color, ctx->t, ctx->ti);
+	pthread_mutex_lock(&u->pool->mutex);
+	u->pool->active--;
+	pthread_cond_broadcast(&u->pool->pause_cond);
+	pthread_mutex_unlock(&u->pool->mutex);
 	
 	/* Finish */
 	pthread_mutex_lock(&finish_serializer);
@@ -156,6 +193,110 @@ spawn_worker(void *ctx_)
 	return ctx;
 }
 
+/* Worker thread main loop: wait for a search, run it, repeat. */
+static void *
+pool_worker(void *ctx_)
+{
+	uct_thread_ctx_t *ctx = (uct_thread_ctx_t*)ctx_;
+	uct_pool_t *pool = ctx->u->pool;
+	unsigned int search = 0;
+
+	while (true) {
+		pthread_mutex_lock(&pool->mutex);
+		while (pool->search == search && !pool->quit)
+			pthread_cond_wait(&pool->start_cond, &pool->mutex);
+		search = pool->search;
+		bool quit = pool->quit;
+		pthread_mutex_unlock(&pool->mutex);
+		if (quit)  return NULL;
+
+		spawn_worker(ctx);
+	}
+}
+
+void
+uct_pool_init(uct_t *u)
+{
+	assert(u->threads > 0 && !u->pool);
+	uct_pool_t *pool = u->pool = calloc2(1, uct_pool_t);
+	pool->threads = u->threads;
+	pool->ids = calloc2(u->threads, pthread_t);
+	pool->ctx = calloc2(u->threads, uct_thread_ctx_t);
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->start_cond, NULL);
+	pthread_cond_init(&pool->ready_cond, NULL);
+	pthread_cond_init(&pool->wake_cond, NULL);
+	pthread_cond_init(&pool->pause_cond, NULL);
+
+	pthread_attr_t a;
+	pthread_attr_init(&a);
+	pthread_attr_setstacksize(&a, 1048576);
+	for (int ti = 0; ti < u->threads; ti++) {
+		pool->ctx[ti].u = u;
+		pool->ctx[ti].tid = ti;
+		pthread_create(&pool->ids[ti], &a, pool_worker, &pool->ctx[ti]);
+		if (u->pin_threads && !numa_pin_thread(pool->ids[ti], numa_worker_cpu(ti)) && !ti)
+			if (UDEBUGL(1))  fprintf(stderr, "uct: couldn't pin search threads\n");
+	}
+	pthread_attr_destroy(&a);
+}
+
+void
+uct_pool_print_numa_stats(uct_t *u, tree_t *t)
+{
+	int nodes = numa_node_count();
+	if (nodes < 2 || !t->nodes)
+		return;
+
+	/* Where workers run: pinned, or anywhere. */
+	double workers[NUMA_MAX_NODES] = { 0 };
+	for (int ti = 0; ti < u->threads; ti++)
+		if (u->pin_threads)
+			workers[numa_cpu_to_node(numa_worker_cpu(ti))] += 1.0 / u->threads;
+		else
+			for (int k = 0; k < nodes; k++)
+				workers[k] += 1.0 / (nodes * u->threads);
+
+	int pages[NUMA_MAX_NODES];
+	int n = numa_mem_pages(t->nodes, t->nodes_size, 4096, pages);
+	if (!n)
+		return;
+
+	/* Estimate, assuming all tree pages are accessed alike. */
+	double local = 0;
+	fprintf(stderr, "numa: tree pages");
+	for (int k = 0; k < nodes; k++) {
+		fprintf(stderr, " node%d %.0f%%", k, 100.0 * pages[k] / n);
+		local += workers[k] * pages[k] / n;
+	}
+	fprintf(stderr, ", est. remote accesses %.0f%%\n", 100 * (1 - local));
+}
+
+void
+uct_pool_done(uct_t *u)
+{
+	uct_pool_t *pool = u->pool;
+	if (!pool)  return;
+	assert(!thread_manager_running);
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->quit = true;
+	pthread_cond_broadcast(&pool->start_cond);
+	pthread_mutex_unlock(&pool->mutex);
+	for (int ti = 0; ti < pool->threads; ti++)
+		pthread_join(pool->ids[ti], NULL);
+
+	pthread_cond_destroy(&pool->pause_cond);
+	pthread_cond_destroy(&pool->wake_cond);
+	pthread_cond_destroy(&pool->ready_cond);
+	pthread_cond_destroy(&pool->start_cond);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool->ctx);
+	free(pool->ids);
+	free(pool);
+	u->pool = NULL;
+}
+
 /* Thread manager, controlling worker threads. It must be called with
  * finish_mutex lock held, but it will unlock it itself before exiting;
  * this is necessary to be completely deadlock-free. */
@@ -174,7 +315,9 @@ spawn_thread_manager(void *ctx_)
 	fast_srandom(mctx->seed);
 
 	int played_games = 0;
-	pthread_t threads[u->threads + 1];
+	pthread_t logger;
+	uct_pool_t *pool = u->pool;
+	assert(pool && pool->threads == u->threads);
 	int joined = 0;
 
 	uct_halt = 0;
@@ -188,22 +331,29 @@ spawn_thread_manager(void *ctx_)
 		
 	/* Logging thread for pondering */
 	if (u->pondering)
-		pthread_create(&threads[u->threads], NULL, spawn_logger, mctx);
+		pthread_create(&logger, NULL, spawn_logger, mctx);
+
+	/* Batched dcnn evaluation thread */
+	dcnn_queue_start(u, mctx->b);
+
+	/* Concurrent garbage collection thread */
+	if (t->gc)  tree_gc_start(t);
 	
-	/* Spawn threads... */
+	/* Wake up workers... */
 	for (int ti = 0; ti < u->threads; ti++) {
-		uct_thread_ctx_t *ctx = malloc2(uct_thread_ctx_t);
+		uct_thread_ctx_t *ctx = &pool->ctx[ti];
 		ctx->u = u; ctx->b = mctx->b; ctx->color = mctx->color;
 		mctx->t = ctx->t = t;
 		ctx->tid = ti; ctx->seed = fast_random(65536) + ti;
 		ctx->ti = mctx->ti;
-		pthread_attr_t a;
-		pthread_attr_init(&a);
-		pthread_attr_setstacksize(&a, 1048576);
-		pthread_create(&threads[ti], &a, spawn_worker, ctx);
-		if (UDEBUGL(4))
-			fprintf(stderr, "Spawned worker %d\n", ti);
+		ctx->games = 0;
 	}
+	pthread_mutex_lock(&pool->mutex);
+	pool->search++;
+	pthread_cond_broadcast(&pool->start_cond);
+	pthread_mutex_unlock(&pool->mutex);
+	if (UDEBUGL(4))
+		fprintf(stderr, "Started %d workers\n", u->threads);
 
 	/* ...and collect them back: */
 	while (joined < u->threads) {
@@ -221,18 +371,20 @@ spawn_thread_manager(void *ctx_)
 			continue;
 		}
 		/* ...and gather its remnants. */
-		uct_thread_ctx_t *ctx;
-		pthread_join(threads[finish_thread], (void **) &ctx);
-		played_games += ctx->games;
+		played_games += pool->ctx[finish_thread].games;
 		joined++;
-		free(ctx);
 		if (UDEBUGL(4))
-			fprintf(stderr, "Joined worker %d\n", finish_thread);
+			fprintf(stderr, "Worker %d done\n", finish_thread);
 		pthread_mutex_unlock(&finish_serializer);
 	}
 
 	if (u->pondering)
-		pthread_join(threads[u->threads], NULL);
+		pthread_join(logger, NULL);
+
+	/* Pending dcnn evaluations are dropped, tree may change after search. */
+	dcnn_queue_stop();
+
+	if (t->gc)  tree_gc_stop(t);
 	
 	pthread_mutex_unlock(&finish_mutex);
 
@@ -342,7 +494,141 @@ uct_expand_next_best_moves(uct_t *u, tree_t *t, board_t *b, enum stone color)
 int
 uct_search_games(uct_search_state_t *s)
 {
-	return s->ctx->t->root->u.playouts;
+	return node_u(s->ctx->t->root).playouts;
+}
+
+void
+uct_search_wakeup(uct_t *u)
+{
+	uct_pool_t *pool = u->pool;
+	pthread_mutex_lock(&pool->mutex);
+	pool->wake = true;
+	pthread_cond_signal(&pool->wake_cond);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void
+uct_search_wait(uct_t *u, time_info_t *ti, uct_search_state_t *s)
+{
+	uct_pool_t *pool = u->pool;
+	double now = time_now();
+	double deadline = now + TREE_BUSYWAIT_INTERVAL;
+
+	/* Wake up right when a time limit is crossed. Limits are checked
+	 * against timer start, except minimum search time which counts
+	 * from search start (later). */
+	if (ti && ti->dim == TD_WALLTIME) {
+		double start = ti->len.t.timer_start;
+		double times[] = { start + TREE_BUSYWAIT_INTERVAL, start + TIME_EARLY_BREAK_MIN,
+				   start + s->stop.desired.time, start + s->stop.worst.time,
+				   s->start_time + TREE_BUSYWAIT_INTERVAL };
+		for (unsigned int k = 0; k < sizeof(times) / sizeof(*times); k++) {
+			double t = times[k] + 0.0005;
+			if (t > now && t < deadline)  deadline = t;
+		}
+	}
+
+	struct timespec ts;
+	double sec;
+	ts.tv_nsec = (long)(modf(deadline, &sec) * 1000000000.0);
+	ts.tv_sec = (time_t)sec;
+
+	pthread_mutex_lock(&pool->mutex);
+	while (!pool->wake)
+		if (pthread_cond_timedwait(&pool->wake_cond, &pool->mutex, &ts) == ETIMEDOUT)
+			break;
+	pool->wake = false;
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void
+uct_worker_pause(uct_t *u)
+{
+	uct_pool_t *pool = u->pool;
+	pthread_mutex_lock(&pool->mutex);
+	pool->paused++;
+	pthread_cond_broadcast(&pool->pause_cond);
+	while (u->pause)
+		pthread_cond_wait(&pool->pause_cond, &pool->mutex);
+	pool->paused--;
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+/* Stop the world: wait until all running workers are parked.
+ * Workers entering uct_playouts() meanwhile park right away. */
+static void
+uct_search_pause(uct_t *u)
+{
+	uct_pool_t *pool = u->pool;
+	pthread_mutex_lock(&pool->mutex);
+	u->pause = true;
+	while (pool->paused < pool->active)
+		pthread_cond_wait(&pool->pause_cond, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+static void
+uct_search_resume(uct_t *u)
+{
+	uct_pool_t *pool = u->pool;
+	pthread_mutex_lock(&pool->mutex);
+	u->pause = false;
+	pthread_cond_broadcast(&pool->pause_cond);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+/* Tree is full: pause the search and recycle least visited nodes.
+ * dcnn evaluations in flight and gc snapshot refer to nodes that
+ * move, they are dropped. */
+static void
+uct_search_recycle(uct_t *u, board_t *b, tree_t *t)
+{
+	uct_search_pause(u);
+	dcnn_queue_stop();
+	if (t->gc)  tree_gc_stop(t);
+
+	t->root = tree_recycle(t);
+
+	if (t->gc)  tree_gc_start(t);
+	dcnn_queue_start(u, b);
+	uct_search_resume(u);
+}
+
+/* Next root playouts count at which search could stop:
+ * playout thresholds, or earliest point where best move could be
+ * found unreachable by uct_search_stop_early(). */
+static int
+uct_search_next_milestone(uct_t *u, time_info_t *ti, uct_search_state_t *s,
+			  tree_node_t *best, tree_node_t *best2, int i)
+{
+	int next = INT_MAX;
+#define milestone(n)  do {  int n_ = (n);  if (n_ > i && n_ < next)  next = n_;  } while (0)
+
+	milestone(GJ_MINGAMES);
+	if (ti->dim == TD_GAMES) {
+		milestone(s->stop.desired.playouts + 1);
+		milestone(s->stop.worst.playouts + 1);
+	}
+	if (!best)  return next;
+
+	/* best can gain at most one playout per game. */
+	if (node_u(best).playouts < PLAYOUT_EARLY_BREAK_MIN)
+		milestone(i + PLAYOUT_EARLY_BREAK_MIN - node_u(best).playouts);
+
+	/* Each game can bring best one playout closer to best2 and
+	 * use up one estimated remaining playout: gap closes by 2 at most. */
+	bool time_indulgent = (!ti->len.t.main_time && ti->len.t.byoyomi_stones == 1);
+	int played = u->played_all + i - s->base_playouts;
+	double elapsed = time_now() - ti->len.t.timer_start;
+	if (best2 && ti->dim == TD_WALLTIME && !time_indulgent && elapsed > 0) {
+		double remaining = s->stop.worst.time - elapsed;
+		double estplayouts = remaining * played / elapsed + PLAYOUT_DELTA_SAFEMARGIN;
+		double gap = node_u(best2).playouts + estplayouts - node_u(best).playouts;
+		if (gap < INT_MAX / 4)
+			milestone(i + (gap > 2 ? (int)(gap / 2) : 1));
+	}
+#undef milestone
+	return next;
 }
 
 void
@@ -351,9 +637,12 @@ uct_search_start(uct_t *u, board_t *b, enum stone color,
 		 uct_search_state_t *s)
 {
 	/* Set up search state. */
-	s->base_playouts = s->last_dynkomi = s->last_print = t->root->u.playouts;
+	s->base_playouts = s->last_dynkomi = s->last_print = node_u(t->root).playouts;
 	s->print_interval = u->reportfreq;
 	s->fullmem = false;
+	s->start_time = time_now();
+	u->milestone = GJ_MINGAMES;
+	u->pool->wake = false;
 
 	if (ti) {
 		if (ti->period == TT_NULL) {
@@ -425,6 +714,12 @@ uct_search_progress(uct_t *u, board_t *b, enum stone color,
 		uct_progress_status(u, ctx->t, color, s->last_print, NULL);
 	}
 
+	if (!s->fullmem && ctx->t->nodes_size > u->max_tree_size &&
+	    u->recycle && ctx->t->nodes && !u->slave && u->tree_ready) {
+		uct_search_recycle(u, b, ctx->t);
+		return;
+	}
+
 	if (!s->fullmem && ctx->t->nodes_size > u->max_tree_size) {
 		char *msg = "WARNING: Tree memory limit reached, stopping search.\n"
 			    "Try increasing max_tree_size.\n";
@@ -472,19 +767,19 @@ uct_search_stop_early(uct_t *u, tree_t *t, board_t *b,
 		double remaining = stop->worst.time - elapsed;
 		double pps = ((double)played) / elapsed;
 		double estplayouts = remaining * pps + PLAYOUT_DELTA_SAFEMARGIN;
-		if (best->u.playouts > best2->u.playouts + estplayouts) {
+		if (node_u(best).playouts > node_u(best2).playouts + estplayouts) {
 			if (UDEBUGL(2))
 				fprintf(stderr, "Early stop, result cannot change: "
 					"best %d, best2 %d, estimated %f simulations to go (%d/%f=%f pps)\n",
-					best->u.playouts, best2->u.playouts, estplayouts, played, elapsed, pps);
+					node_u(best).playouts, node_u(best2).playouts, estplayouts, played, elapsed, pps);
 			return true;
 		}
 	}
 
 	/* Early break in won situation. */
-	if (best->u.playouts >= PLAYOUT_EARLY_BREAK_MIN
+	if (node_u(best).playouts >= PLAYOUT_EARLY_BREAK_MIN
 	    && (ti->dim != TD_WALLTIME || elapsed > TIME_EARLY_BREAK_MIN)
-	    && tree_node_get_value(t, 1, best->u.value) >= u->sure_win_threshold) {
+	    && tree_node_get_value(t, 1, node_u(best).value) >= u->sure_win_threshold) {
 		return true;
 	}
 
@@ -506,7 +801,7 @@ uct_search_keep_looking(uct_t *u, tree_t *t, board_t *b,
 
 	/* Do not waste time if we are winning. Spend up to worst time if
 	 * we are unsure, but only desired time if we are sure of winning. */
-	floating_t beta = 2 * (tree_node_get_value(t, 1, best->u.value) - 0.5);
+	floating_t beta = 2 * (tree_node_get_value(t, 1, node_u(best).value) - 0.5);
 	if (ti->dim == TD_WALLTIME && beta > 0) {
 		double good_enough = stop->desired.time * beta + stop->worst.time * (1 - beta);
 		double elapsed = time_now() - ti->len.t.timer_start;
@@ -517,11 +812,11 @@ uct_search_keep_looking(uct_t *u, tree_t *t, board_t *b,
 		/* Check best/best2 simulations ratio. If the
 		 * two best moves give very similar results,
 		 * keep simulating. */
-		if (best2 && best2->u.playouts
-		    && (double)best->u.playouts / best2->u.playouts < u->best2_ratio) {
+		if (best2 && node_u(best2).playouts
+		    && (double)node_u(best).playouts / node_u(best2).playouts < u->best2_ratio) {
 			if (UDEBUGL(3))
 				fprintf(stderr, "Best2 ratio %f < threshold %f\n",
-					(double)best->u.playouts / best2->u.playouts,
+					(double)node_u(best).playouts / node_u(best2).playouts,
 					u->best2_ratio);
 			return true;
 		}
@@ -531,11 +826,11 @@ uct_search_keep_looking(uct_t *u, tree_t *t, board_t *b,
 		/* Check best, best_best value difference. If the best move
 		 * and its best child do not give similar enough results,
 		 * keep simulating. */
-		if (bestr && bestr->u.playouts
-		    && fabs((double)best->u.value - bestr->u.value) > u->bestr_ratio) {
+		if (bestr && node_u(bestr).playouts
+		    && fabs((double)node_u(best).value - node_u(bestr).value) > u->bestr_ratio) {
 			if (UDEBUGL(3))
 				fprintf(stderr, "Bestr delta %f > threshold %f\n",
-					fabs((double)best->u.value - bestr->u.value),
+					fabs((double)node_u(best).value - node_u(bestr).value),
 					u->bestr_ratio);
 			return true;
 		}
@@ -547,9 +842,9 @@ uct_search_keep_looking(uct_t *u, tree_t *t, board_t *b,
 		if (UDEBUGL(3))
 			fprintf(stderr, "[%d] best %3s [%d] %f != winner %3s [%d] %f\n", i,
 				coord2sstr(node_coord(best)),
-				best->u.playouts, tree_node_get_value(t, 1, best->u.value),
+				node_u(best).playouts, tree_node_get_value(t, 1, node_u(best).value),
 				coord2sstr(node_coord(winner)),
-				winner->u.playouts, tree_node_get_value(t, 1, winner->u.value));
+				node_u(winner).playouts, tree_node_get_value(t, 1, node_u(winner).value));
 		return true;
 	}
 
@@ -557,10 +852,12 @@ uct_search_keep_looking(uct_t *u, tree_t *t, board_t *b,
 	return false;
 }
 
-bool
-uct_search_check_stop(uct_t *u, board_t *b, enum stone color,
-		      tree_t *t, time_info_t *ti,
-		      uct_search_state_t *s, int i)
+/* Whether search should stop now. Sets *best_ and *best2_ if it
+ * gets to compute them. */
+static bool
+uct_search_stop_now(uct_t *u, board_t *b, enum stone color,
+		    tree_t *t, time_info_t *ti, uct_search_state_t *s, int i,
+		    tree_node_t **best_, tree_node_t **best2_)
 {
 	uct_thread_ctx_t *ctx = s->ctx;
 
@@ -570,8 +867,19 @@ uct_search_check_stop(uct_t *u, board_t *b, enum stone color,
 	 * up otherwise - we might even play invalid suicides or pass
 	 * when we mustn't. */
 	assert(!(ti->dim == TD_GAMES && ti->len.games < GJ_MINGAMES));
+
+	/* Solver: nothing more to find out if root is a proven win. */
+	if (ctx->t->root->proven == proven_win(color)) {
+		if (UDEBUGL(2))  fprintf(stderr, "Stopping search, proven win.\n");
+		return true;
+	}
+
 	if (i < GJ_MINGAMES)
 		return false;
+	/* Likewise, search at least TREE_BUSYWAIT_INTERVAL even if time
+	 * control says otherwise, the move is completely random otherwise. */
+	if (ti->dim == TD_WALLTIME && time_now() - s->start_time < TREE_BUSYWAIT_INTERVAL)
+		return false;
 
 	tree_node_t *best = NULL;
 	tree_node_t *best2 = NULL; // Second-best move.
@@ -580,6 +888,7 @@ uct_search_check_stop(uct_t *u, board_t *b, enum stone color,
 
 	best = u->policy->choose(u->policy, ctx->t->root, b, color, resign);
 	if (best) best2 = u->policy->choose(u->policy, ctx->t->root, b, color, node_coord(best));
+	*best_ = best;  *best2_ = best2;
 
 	/* Possibly stop search early if it's no use to try on. */
 	int played = u->played_all + i - s->base_playouts;
@@ -618,6 +927,21 @@ uct_search_check_stop(uct_t *u, board_t *b, enum stone color,
 	return false;
 }
 
+bool
+uct_search_check_stop(uct_t *u, board_t *b, enum stone color,
+		      tree_t *t, time_info_t *ti,
+		      uct_search_state_t *s, int i)
+{
+	tree_node_t *best = NULL, *best2 = NULL;
+	if (uct_search_stop_now(u, b, color, t, ti, s, i, &best, &best2))
+		return true;
+
+	/* Whichever check we stopped at, workers must wake us up
+	 * at next milestone. */
+	u->milestone = uct_search_next_milestone(u, ti, s, best, best2, i);
+	return false;
+}
+
 /* uct_pass_is_safe() also called by uct policy, beware.  */
 static bool
 uct_search_pass_is_safe(uct_t *u, board_t *b, enum stone color, bool pass_all_alive, char **msg)
@@ -673,13 +997,13 @@ uct_search_result(uct_t *u, board_t *b, enum stone color,
 		return NULL;
 	}
 	*best_coord = node_coord(best);
-	floating_t winrate = tree_node_get_value(u->t, 1, best->u.value);
+	floating_t winrate = tree_node_get_value(u->t, 1, node_u(best).value);
 
 	if (UDEBUGL(1))
 		fprintf(stderr, "*** WINNER is %s with score %1.4f (%d/%d:%d/%d games), extra komi %f\n",
 			coord2sstr(node_coord(best)), winrate,
-			best->u.playouts, u->t->root->u.playouts,
-			u->t->root->u.playouts - base_playouts, played_games,
+			node_u(best).playouts, node_u(u->t->root).playouts,
+			node_u(u->t->root).playouts - base_playouts, played_games,
 			u->t->extra_komi);
 
 	/* Do not resign if we're so short of time that evaluation of best
@@ -689,7 +1013,7 @@ uct_search_result(uct_t *u, board_t *b, enum stone color,
 	    // If only simulated node has been a pass and no other node has
 	    // been simulated but pass won't win, an unsimulated node has
 	    // been returned; test therefore also for #simulations at root.
-	    && (best->u.playouts > GJ_MINGAMES || u->t->root->u.playouts > GJ_MINGAMES * 2)
+	    && (node_u(best).playouts > GJ_MINGAMES || node_u(u->t->root).playouts > GJ_MINGAMES * 2)
 	    && !u->t->untrustworthy_tree) {
 		if (UDEBUGL(0)) fprintf(stderr, "<resign>\n");
 		*best_coord = resign;
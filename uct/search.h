@@ -8,6 +8,7 @@
 /* walk.c controls repeated walking of the MCTS tree within
  * the search threads. */
 
+#include <limits.h>
 #include <signal.h> // sig_atomic_t
 
 #include "debug.h"
@@ -23,7 +24,8 @@ struct tree_node;
 /* Internal UCT structures */
 
 /* How often to inspect the tree from the main thread to check for playout
- * stop, progress reports, etc. (in seconds) */
+ * stop, progress reports, etc. (in seconds). Search stop is checked at the
+ * exact time deadlines and playout milestones in between, see uct_search_wait() */
 #define TREE_BUSYWAIT_INTERVAL 0.1 /* 100ms */
 
 
@@ -59,14 +61,42 @@ typedef struct uct_search_state {
 	int print_interval;
 	/* Printed notification about full memory? */
 	bool fullmem;
+	/* When search started. */
+	double start_time;
 
 	time_stop_t stop;
 	uct_thread_ctx_t *ctx;
 } uct_search_state_t;
 
 
+/* Persistent search threads, set up once per engine. */
+void uct_pool_init(uct_t *u);
+void uct_pool_done(uct_t *u);
+/* Tree memory placement vs workers (NUMA machines only). */
+void uct_pool_print_numa_stats(uct_t *u, tree_t *t);
+
 int uct_search_games(uct_search_state_t *s);
 
+/* Wait until next search stop check is due: next time deadline,
+ * TREE_BUSYWAIT_INTERVAL at most, or woken up by a worker. */
+void uct_search_wait(uct_t *u, time_info_t *ti, uct_search_state_t *s);
+void uct_search_wakeup(uct_t *u);
+
+/* Workers: wake up search controller when root reaches next playout milestone.
+ * Only one worker wakes it up, and a milestone the controller just set is
+ * never overwritten. */
+static inline void
+uct_search_milestone(uct_t *u, tree_t *t)
+{
+	int milestone = u->milestone;
+	if (node_u(t->root).playouts >= milestone
+	    && __sync_bool_compare_and_swap(&u->milestone, milestone, INT_MAX))
+		uct_search_wakeup(u);
+}
+
+/* Workers: park while search is paused (tree recycling). */
+void uct_worker_pause(uct_t *u);
+
 void uct_search_start(uct_t *u, board_t *b, enum stone color, tree_t *t, time_info_t *ti, uct_search_state_t *s);
 uct_thread_ctx_t *uct_search_stop(void);
 
@@ -233,7 +233,7 @@ receive_stats(uct_t *u, int size)
 		if (!node) continue;
 
 		/* node_total += others_incr */
-		stats_add_result(&node->u, is.incr.value, is.incr.playouts);
+		stats_add_result(&node_u(node), is.incr.value, is.incr.playouts);
 
 		/* last_total += others_incr */
 		stats_add_result(&node->pu, is.incr.value, is.incr.playouts);
@@ -277,7 +277,7 @@ append_stats(stats_candidate_t *stats_queue, tree_node_t *node, int stats_count,
 		if (is_pass(node_coord(ni))) continue;
 		if (ni->hints & TREE_HINT_INVALID) continue;
 
-		int incr = ni->u.playouts - ni->pu.playouts;
+		int incr = node_u(ni).playouts - ni->pu.playouts;
 		if (incr < min_increment) continue;
 
 		/* min_increment should be tuned to avoid overflow. */
@@ -339,16 +339,16 @@ select_best_stats(stats_candidate_t *stats_queue, int stats_count,
 		if (delta < 0 || (delta == 0 && --min_count < 0)) continue;
 
 		tree_node_t *node = stats_queue[count].node;
-		os->incr = node->u;
+		os->incr = node_u(node);
 		stats_rm_result(&os->incr, node->pu.value, node->pu.playouts);
 
 		/* With virtual loss os->incr.playouts might be <= 0; we only
 		 * send positive increments to other slaves so a virtual loss
 		 * can be propagated to other machines (good). The undo of the
-		 * virtual loss will be propagated later when node->u gets
+		 * virtual loss will be propagated later when node_u(node) gets
 		 * above node->pu. */
 		if (os->incr.playouts > 0) {
-			node->pu = node->u;
+			node->pu = node_u(node);
 			os->coord_path = stats_queue[count].coord_path;
 			assert(os->coord_path > 0);
 			os++;
@@ -412,10 +412,10 @@ report_incr_stats(uct_t *u, int *stats_size)
 	if (DEBUGVV(2))
 		fprintf(stderr,
 			"min_incr %d games %d stats_queue %d/%d sending %d/%d in %.3fms\n",
-			min_increment, root->u.playouts - root->pu.playouts, stats_count,
+			min_increment, node_u(root).playouts - root->pu.playouts, stats_count,
 			max_nodes, *stats_size / (int)sizeof(incr_stats_t), u->shared_nodes,
 			(time_now() - start_time)*1000);
-	root->pu = root->u;
+	root->pu = node_u(root);
 	return buf;
 }
 
@@ -436,9 +436,9 @@ report_stats(uct_t *u, board_t *b, coord_t c,
 	char *r = reply;
 	char *end = reply + sizeof(reply);
 	tree_node_t *root = u->t->root;
-	r += snprintf(r, end - r, "%d %d %d %d @%d", u->played_own, root->u.playouts,
+	r += snprintf(r, end - r, "%d %d %d %d @%d", u->played_own, node_u(root).playouts,
 		      u->threads, keep_looking, bin_size);
-	int min_playouts = root->u.playouts / 100;
+	int min_playouts = node_u(root).playouts / 100;
 	if (min_playouts < GJ_MINGAMES)
 		min_playouts = GJ_MINGAMES;
 	int max_playouts = 1;
@@ -450,9 +450,9 @@ report_stats(uct_t *u, board_t *b, coord_t c,
 		if (is_pass(node_coord(ni))) continue;
 		assert(node_coord(ni) > 0 && node_coord(ni) < board_max_coords(b));
 
-		if (ni->u.playouts > max_playouts)
-			max_playouts = ni->u.playouts;
-		if (ni->u.playouts <= min_playouts || ni->hints & TREE_HINT_INVALID)
+		if (node_u(ni).playouts > max_playouts)
+			max_playouts = node_u(ni).playouts;
+		if (node_u(ni).playouts <= min_playouts || ni->hints & TREE_HINT_INVALID)
 			continue;
 		/* A book move is only added at the end: */
 		if (node_coord(ni) == c) continue;
@@ -460,7 +460,7 @@ report_stats(uct_t *u, board_t *b, coord_t c,
 		char buf[4];
 		/* We return the values as stored in the tree, so from black's view. */
 		r += snprintf(r, end - r, "\n%s %d %.16f", coord2bstr(buf, node_coord(ni)),
-			      ni->u.playouts, ni->u.value);
+			      node_u(ni).playouts, node_u(ni).value);
 	}
 	/* Give a large but not infinite weight to pass, resign or book move, to avoid
 	 * forcing resign if other slaves don't like it. */
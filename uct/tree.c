@@ -1,10 +1,14 @@
 #include <assert.h>
+#include <limits.h>
 #include <math.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 #define DEBUG
 #include "board.h"
@@ -18,43 +22,353 @@
 #include "uct/prior.h"
 #include "uct/tree.h"
 #include "uct/slave.h"
+#include "uct/dcnn_queue.h"
 #include "dcnn.h"
 
 
-/* Allocate tree node(s). The returned nodes are initialized with zeroes.
+/* Byte size of a block of count nodes along with their stats. */
+#define tree_block_size(count) ((count) * (sizeof(tree_node_t) + 3 * sizeof(move_stats_t)))
+
+/* Round allocation size so that next block's nodes are aligned
+ * (pending moves arrays can have any size). */
+#define tree_align(size)  (((size) + __alignof__(tree_node_t) - 1) & ~(size_t)(__alignof__(tree_node_t) - 1))
+
+
+/* Arena allocator used for tree nodes when fast_alloc is off.
+ * Blocks are carved out of large zeroed chunks, each thread filling its
+ * own chunk so threads don't contend on allocation. Blocks are never freed
+ * one by one: on promotion the subtree we keep stays where it is, we walk it
+ * to find chunks still holding some of its nodes and release all other chunks
+ * at once, there is no need to walk the discarded part of the tree. Chunks
+ * with few survivors are kept until these die out a few moves later.
+ * The arena grows on demand. */
+
+#define TREE_ARENA_CHUNK  (4 * 1024 * 1024)
+
+typedef struct tree_arena_chunk {
+	struct tree_arena_chunk *next;
+	size_t size;
+	size_t live;		/* Bytes used by surviving blocks (reclaim) */
+} tree_arena_chunk_t;	/* Followed by chunk data. */
+
+typedef struct tree_arena {
+	unsigned int id;	/* Unique, thread caches refer to it. */
+	pthread_mutex_t lock;
+	tree_arena_chunk_t *chunks;
+	size_t size;		/* Bytes allocated for chunks. */
+} tree_arena_t;
+
+/* Chunk being filled by a thread. */
+typedef struct {
+	unsigned int arena_id;
+	char *ptr, *end;
+} tree_arena_cache_t;
+
+#ifndef NO_THREAD_LOCAL
+static __thread tree_arena_cache_t arena_cache;
+#else
+/* No thread local storage, share it and allocate under the arena lock. */
+static tree_arena_cache_t arena_cache;
+#endif
+
+static unsigned int
+tree_arena_new_id(void)
+{
+	static unsigned int ids = 0;
+	return __sync_add_and_fetch(&ids, 1);
+}
+
+static tree_arena_t *
+tree_arena_init(void)
+{
+	tree_arena_t *a = calloc2(1, tree_arena_t);
+	a->id = tree_arena_new_id();
+	pthread_mutex_init(&a->lock, NULL);
+	return a;
+}
+
+/* Get a new chunk for current thread, with room for at least size bytes. */
+static void
+tree_arena_grow(tree_arena_t *a, size_t size)
+{
+	size_t csize = sizeof(tree_arena_chunk_t) + size;
+	if (csize < TREE_ARENA_CHUNK)  csize = TREE_ARENA_CHUNK;
+	tree_arena_chunk_t *c = (tree_arena_chunk_t *)calloc2(csize, char);
+	c->size = csize;
+
+	pthread_mutex_lock(&a->lock);
+	c->next = a->chunks;
+	a->chunks = c;
+	a->size += csize;
+	pthread_mutex_unlock(&a->lock);
+
+	arena_cache.arena_id = a->id;
+	arena_cache.ptr = (char *)(c + 1);
+	arena_cache.end = (char *)c + csize;
+}
+
+/* Returns zeroed memory. May be called by multiple threads in parallel. */
+static void *
+tree_arena_alloc(tree_arena_t *a, size_t size)
+{
+	size = tree_align(size);
+#ifdef NO_THREAD_LOCAL
+	pthread_mutex_lock(&a->lock);
+#endif
+	if (arena_cache.arena_id != a->id || arena_cache.ptr + size > arena_cache.end)
+		tree_arena_grow(a, size);
+	void *p = arena_cache.ptr;
+	arena_cache.ptr += size;
+#ifdef NO_THREAD_LOCAL
+	pthread_mutex_unlock(&a->lock);
+#endif
+	return p;
+}
+
+/* Release all chunks at once. */
+static void
+tree_arena_done(tree_arena_t *a)
+{
+	tree_arena_chunk_t *c = a->chunks;
+	while (c) {
+		tree_arena_chunk_t *next = c->next;
+		free(c);
+		c = next;
+	}
+	pthread_mutex_destroy(&a->lock);
+	free(a);
+}
+
+static void *
+tree_arena_done_worker(void *arena)
+{
+	tree_arena_t *a = (tree_arena_t*)arena;
+	size_t size = a->size;
+	tree_arena_done(a);
+	if (DEBUGL(3))
+		fprintf(stderr, "released %lluMb of tree nodes\n", (unsigned long long)size / 1048576);
+	return NULL;
+}
+
+/* Release arena chunks asynchronously if it's big, giving pages back to
+ * the system can take a while. */
+static void
+tree_arena_done_detached(tree_arena_t *a)
+{
+	if (a->size < 64 * TREE_ARENA_CHUNK) {
+		tree_arena_done(a);
+		return;
+	}
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	pthread_t thread;
+	pthread_create(&thread, &attr, tree_arena_done_worker, a);
+	pthread_attr_destroy(&attr);
+}
+
+typedef struct {
+	tree_arena_chunk_t **chunks;	/* Sorted by address */
+	int nchunks;
+	tree_arena_chunk_t *chunk;	/* Last chunk found */
+} tree_arena_mark_t;
+
+static int
+chunk_cmp(const void *a, const void *b)
+{
+	const tree_arena_chunk_t *c1 = *(tree_arena_chunk_t * const *)a;
+	const tree_arena_chunk_t *c2 = *(tree_arena_chunk_t * const *)b;
+	return (c1 < c2 ? -1 : c1 > c2);
+}
+
+/* Account size bytes of block first to the chunk holding it. */
+static void
+tree_arena_mark_block(tree_arena_mark_t *m, tree_node_t *first, size_t size)
+{
+	char *p = (char *)first;
+	tree_arena_chunk_t *c = m->chunk;
+	if (!c || p < (char *)c || p >= (char *)c + c->size) {
+		int lo = 0, hi = m->nchunks - 1;
+		while (lo < hi) {	/* Last chunk starting before p */
+			int mid = (lo + hi + 1) / 2;
+			if ((char *)m->chunks[mid] <= p)  lo = mid;
+			else                              hi = mid - 1;
+		}
+		c = m->chunk = m->chunks[lo];
+		assert(p >= (char *)c && p < (char *)c + c->size);
+	}
+	c->live += size;
+}
+
+/* Mark blocks of node's subtree. Nodes of a block are consecutive
+ * in the sibling chain, so each block is accounted only once. */
+static void
+tree_arena_mark(tree_arena_mark_t *m, tree_node_t *node)
+{
+	tree_node_t *block = NULL;
+	for (tree_node_t *ni = node->children; ni; ni = ni->sibling) {
+		tree_node_t *first = tree_block_first(ni);
+		if (first != block) {
+			size_t size = tree_block_size(first->count);
+			if (ni == node->children && tree_node_has_pending(node))
+				size += tree_pending_size(tree_node_pending(node)->count);
+			tree_arena_mark_block(m, first, tree_align(size));
+			block = first;
+		}
+		tree_arena_mark(m, ni);
+	}
+}
+
+/* Release chunks holding no node of the subtree rooted at root (which
+ * stays in place). Must not be called while the search is running.
+ * Returns bytes used by the subtree: this is what counts against
+ * max_tree_size, not the (partly dead) chunks holding it. */
+static size_t
+tree_arena_reclaim(tree_arena_t *a, tree_node_t *root)
+{
+	double start = time_now();
+	tree_arena_mark_t m = { 0, };
+	for (tree_arena_chunk_t *c = a->chunks; c; c = c->next)
+		m.nchunks++;
+	if (!m.nchunks)  return 0;
+	m.chunks = calloc2(m.nchunks, tree_arena_chunk_t*);
+	int i = 0;
+	for (tree_arena_chunk_t *c = a->chunks; c; c = c->next) {
+		c->live = 0;
+		m.chunks[i++] = c;
+	}
+	qsort(m.chunks, m.nchunks, sizeof(*m.chunks), chunk_cmp);
+
+	tree_arena_mark_block(&m, tree_block_first(root), sizeof(tree_node_t) + 3 * sizeof(move_stats_t));
+	tree_arena_mark(&m, root);
+	free(m.chunks);
+
+	/* Dead chunks go to a separate arena which is released at once. */
+	tree_arena_t *dead = tree_arena_init();
+	tree_arena_chunk_t **pc = &a->chunks;
+	size_t live = 0;
+	while (*pc) {
+		tree_arena_chunk_t *c = *pc;
+		live += c->live;
+		if (c->live) {
+			pc = &c->next;
+			continue;
+		}
+		*pc = c->next;
+		a->size -= c->size;
+		c->next = dead->chunks;
+		dead->chunks = c;
+		dead->size += c->size;
+	}
+	if (DEBUGL(3))
+		fprintf(stderr, "tree arena: kept %lluMb in %lluMb of chunks, releasing %lluMb (%.3fs)\n",
+			(unsigned long long)live / 1048576, (unsigned long long)a->size / 1048576,
+			(unsigned long long)dead->size / 1048576, time_now() - start);
+	tree_arena_done_detached(dead);
+
+	/* Thread caches may point to released chunks. */
+	a->id = tree_arena_new_id();
+	return live;
+}
+
+
+/* Allocate a block of count sibling nodes. The returned nodes are initialized
+ * with zeroes, their stats live in the block right after them (see tree.h).
+ * Tree nodes come from the nodes buffer (fast_alloc) or the arena, local
+ * tree nodes (local=true) are allocated separately with calloc and are not
+ * accounted in nodes_size.
  * Returns NULL if not enough memory.
  * This function may be called by multiple threads in parallel. */
 static tree_node_t *
-tree_alloc_node(tree_t *t, int count, bool fast_alloc)
+tree_alloc_block(tree_t *t, int count, size_t extra, bool local)
 {
 	tree_node_t *n = NULL;
-	size_t nsize = count * sizeof(*n);
-	size_t old_size = __sync_fetch_and_add(&t->nodes_size, nsize);
+	size_t nsize = tree_align(tree_block_size(count) + extra);
 
-	if (fast_alloc) {
+	if (local) {
+		n = (tree_node_t *)calloc2(nsize, char);
+	} else if (t->nodes) {
+		size_t old_size = __sync_fetch_and_add(&t->nodes_size, nsize);
 		if (old_size + nsize > t->max_tree_size)
 			return NULL;
-		assert(t->nodes != NULL);
 		n = (tree_node_t *)((char*)t->nodes + old_size);
 		memset(n, 0, nsize);
 	} else {
-		n = calloc2(count, tree_node_t);
+		__sync_fetch_and_add(&t->nodes_size, nsize);
+		n = (tree_node_t *)tree_arena_alloc(t->arena, nsize);
+	}
+	for (int i = 0; i < count; i++) {
+		n[i].index = i;
+		n[i].count = count;
 	}
 	return n;
 }
 
+static tree_node_t *
+tree_alloc_node(tree_t *t, int count, bool local)
+{
+	return tree_alloc_block(t, count, 0, local);
+}
+
+/* Allocate block for a copy of node's count children, along with
+ * their pending moves if any (progressive widening). */
+static tree_node_t *
+tree_alloc_children_copy(tree_t *dest, tree_node_t *node, int count)
+{
+	if (!tree_node_has_pending(node))
+		return tree_alloc_node(dest, count, false);
+	tree_pending_t *p = tree_node_pending(node);
+	return tree_alloc_block(dest, count, tree_pending_size(p->count), false);
+}
+
+/* Copy pending moves of node's children to first, a block with count
+ * copied children of n2. Moves widened since are pending again in the copy. */
+static void
+tree_copy_pending(tree_node_t *n2, tree_node_t *first, tree_node_t *node, int count)
+{
+	n2->hints &= ~TREE_HINT_PENDING;
+	if (!tree_node_has_pending(node))
+		return;
+	n2->hints |= TREE_HINT_PENDING;
+	tree_pending_t *p = tree_node_pending(node);
+	tree_pending_t *p2 = tree_block_pending(first);
+	memcpy(p2, p, tree_pending_size(p->count));
+
+	bool copied[BOARD_MAX_COORDS + 1];  memset(copied, 0, sizeof(copied));
+	for (int i = 0; i < count; i++)
+		copied[node_coord(first + i) + 1] = true;
+	p2->lock = 0;
+	p2->children = count;
+	p2->last = first + count - 1;
+	p2->left = 0;
+	for (int i = 0; i < p2->count; i++) {
+		p2->move[i].taken = copied[p2->move[i].coord + 1];
+		if (!p2->move[i].taken)  p2->left++;
+	}
+}
+
+/* Copy node contents and stats from src to dst, keeping dst's place
+ * in its block. */
+static void
+tree_copy_node(tree_node_t *dst, tree_node_t *src)
+{
+	unsigned short index = dst->index, count = dst->count;
+	*dst = *src;
+	dst->index = index;
+	dst->count = count;
+	node_u(dst) = node_u(src);
+	node_amaf(dst) = node_amaf(src);
+	node_prior(dst) = node_prior(src);
+}
+
 /* Initialize a node at a given place in memory.
  * This function may be called by multiple threads in parallel. */
 static void
 tree_setup_node(tree_t *t, tree_node_t *n, coord_t coord, int depth)
 {
-	static volatile unsigned int hash = 0;
 	n->coord = coord;
 	n->depth = depth;
-	/* n->hash is used only for debugging. It is very likely (but not
-	 * guaranteed) to be unique. */
-	hash_t h = n - (tree_node_t *)0;
-	n->hash = (h << 32) + (hash++ & 0xffffffff);
 	if (depth > t->max_depth)
 		t->max_depth = depth;
 }
@@ -63,18 +377,99 @@ tree_setup_node(tree_t *t, tree_node_t *n, coord_t coord, int depth)
  * or exits the main program if not enough memory.
  * This function may be called by multiple threads in parallel. */
 static tree_node_t *
-tree_init_node(tree_t *t, coord_t coord, int depth, bool fast_alloc)
+tree_init_node(tree_t *t, coord_t coord, int depth, bool local)
 {
 	tree_node_t *n;
-	n = tree_alloc_node(t, 1, fast_alloc);
+	n = tree_alloc_node(t, 1, local);
 	if (!n) return NULL;
 	tree_setup_node(t, n, coord, depth);
 	return n;
 }
 
-/* Create a tree structure. Pre-allocate all nodes if max_tree_size is > 0. */
+/* Huge pages: deep searches on large trees spend a lot of time in TLB
+ * misses with regular 4k pages. Explicit huge pages must be reserved
+ * (vm.nr_hugepages), if there aren't enough we fall back to transparent
+ * huge pages, which need THP enabled ('always' or 'madvise'), and
+ * finally regular pages. */
+
+#define TREE_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+#ifndef _WIN32
+static bool
+thp_enabled(void)
+{
+	char buf[128] = "";
+	FILE *f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+	if (!f)  return false;
+	if (!fgets(buf, sizeof(buf), f))  buf[0] = 0;
+	fclose(f);
+	return (buf[0] && !strstr(buf, "[never]"));
+}
+#endif
+
+/* Allocate nodes buffer with the pages asked for in t->huge_pages,
+ * set t->pages to what we got. */
+static void
+tree_alloc_buffer(tree_t *t, size_t size)
+{
+	t->pages = TREE_PAGES_REGULAR;
+#ifndef _WIN32
+	if (t->huge_pages == TREE_PAGES_EXPLICIT) {
+		size_t len = (size + TREE_HUGE_PAGE_SIZE - 1) & ~(size_t)(TREE_HUGE_PAGE_SIZE - 1);
+		void *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (p != MAP_FAILED) {
+			t->nodes = t->nodes_map = p;
+			t->nodes_map_size = len;
+			t->pages = TREE_PAGES_EXPLICIT;
+			return;
+		}
+	}
+#ifdef MADV_HUGEPAGE
+	if (t->huge_pages != TREE_PAGES_REGULAR && thp_enabled()) {
+		/* Start on a huge page boundary so that all of it can be backed. */
+		size_t len = size + TREE_HUGE_PAGE_SIZE;
+		void *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p != MAP_FAILED) {
+			uintptr_t start = ((uintptr_t)p + TREE_HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(TREE_HUGE_PAGE_SIZE - 1);
+			t->nodes = (void *)start;
+			t->nodes_map = p;
+			t->nodes_map_size = len;
+			if (!madvise(t->nodes, size, MADV_HUGEPAGE))
+				t->pages = TREE_PAGES_THP;
+			return;
+		}
+	}
+#endif
+#endif
+	t->nodes = cmalloc(size);
+}
+
+static void
+tree_free_buffer(tree_t *t)
+{
+#ifndef _WIN32
+	if (t->nodes_map) {
+		munmap(t->nodes_map, t->nodes_map_size);
+		return;
+	}
+#endif
+	free(t->nodes);
+}
+
+const char *
+tree_pages_str(enum tree_huge_pages pages)
+{
+	switch (pages) {
+		case TREE_PAGES_THP:       return "transparent huge pages";
+		case TREE_PAGES_EXPLICIT:  return "explicit huge pages";
+		default:                   return "regular pages";
+	}
+}
+
+/* Create a tree structure. Pre-allocate all nodes if max_tree_size is > 0,
+ * otherwise nodes are allocated from an arena as needed. */
 tree_t *
-tree_init(board_t *board, enum stone color, size_t max_tree_size,
+tree_init(board_t *board, enum stone color, size_t max_tree_size, enum tree_huge_pages huge_pages,
 	  size_t max_pruned_size, size_t pruning_threshold, floating_t ltree_aging, int hbits)
 {
 	tree_t *t = calloc2(1, tree_t);
@@ -82,19 +477,21 @@ tree_init(board_t *board, enum stone color, size_t max_tree_size,
 	t->max_tree_size = max_tree_size;
 	t->max_pruned_size = max_pruned_size;
 	t->pruning_threshold = pruning_threshold;
+	t->huge_pages = huge_pages;
 	if (max_tree_size != 0) {
-		t->nodes = cmalloc(max_tree_size);
+		tree_alloc_buffer(t, max_tree_size);
 		/* The nodes buffer doesn't need initialization. This is currently
 		 * done by tree_init_node to spread the load. Doing a memset for the
 		 * entire buffer here would be too slow for large trees (>10 GB). */
-	}
+	} else
+		t->arena = tree_arena_init();
 	/* The root PASS move is only virtual, we never play it. */
-	t->root = tree_init_node(t, pass, 0, t->nodes);
+	t->root = tree_init_node(t, pass, 0, false);
 	t->root_symmetry = board->symmetry;
 	t->root_color = stone_other(color); // to research black moves, root will be white
 
-	t->ltree_black = tree_init_node(t, pass, 0, false);
-	t->ltree_white = tree_init_node(t, pass, 0, false);
+	t->ltree_black = tree_init_node(t, pass, 0, true);
+	t->ltree_white = tree_init_node(t, pass, 0, true);
 	t->ltree_aging = ltree_aging;
 
 	t->hbits = hbits;
@@ -103,66 +500,29 @@ tree_init(board_t *board, enum stone color, size_t max_tree_size,
 }
 
 
-/* This function may be called by multiple threads in parallel on the
- * same tree, but not on node n. n may be detached from the tree but
- * must have been created in this tree originally.
- * It returns the remaining size of the tree after n has been freed. */
-static size_t
-tree_done_node(tree_t *t, tree_node_t *n)
+/* Free all local tree nodes below n. A block is freed once the last of
+ * its nodes found in the sibling chain has been visited. */
+static void
+tree_done_children(tree_t *t, tree_node_t *n)
 {
 	tree_node_t *ni = n->children;
 	while (ni) {
 		tree_node_t *nj = ni->sibling;
-		tree_done_node(t, ni);
+		tree_done_children(t, ni);
+		if (!nj || tree_block_first(nj) != tree_block_first(ni))
+			free(tree_block_first(ni));
 		ni = nj;
 	}
-	free(n);
-	size_t old_size = __sync_fetch_and_sub(&t->nodes_size, sizeof(*n));
-	return old_size - sizeof(*n);
-}
-
-typedef struct {
-	tree_t *t;
-	tree_node_t *n;
-} subtree_ctx_t;
-
-/* Worker thread for tree_done_node_detached(). Only for fast_alloc=false. */
-static void *
-tree_done_node_worker(void *ctx_)
-{
-	subtree_ctx_t *ctx = (subtree_ctx_t*)ctx_;
-	char *str = coord2str(node_coord(ctx->n));
-
-	size_t tree_size = tree_done_node(ctx->t, ctx->n);
-	if (!tree_size)
-		free(ctx->t);
-	if (DEBUGL(2))
-		fprintf(stderr, "done freeing node at %s, tree size %llu\n", str, (unsigned long long)tree_size);
-	free(str);
-	free(ctx);
-	return NULL;
 }
 
-/* Asynchronously free the subtree of nodes rooted at n. If the tree becomes
- * empty free the tree also.  Only for fast_alloc=false. */
+/* Free local tree node n and its subtree. n may be detached from the tree
+ * but must live in a single-node block. */
 static void
-tree_done_node_detached(tree_t *t, tree_node_t *n)
+tree_done_node(tree_t *t, tree_node_t *n)
 {
-	if (n->u.playouts < 1000) { // no thread for small tree
-		if (!tree_done_node(t, n))
-			free(t);
-		return;
-	}
-	pthread_attr_t attr;
-	pthread_attr_init(&attr);
-	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
-
-	pthread_t thread;
-	subtree_ctx_t *ctx = malloc2(subtree_ctx_t);
-	ctx->t = t;
-	ctx->n = n;
-	pthread_create(&thread, &attr, tree_done_node_worker, ctx);
-	pthread_attr_destroy(&attr);
+	assert(n->count == 1);
+	tree_done_children(t, n);
+	free(n);
 }
 
 void
@@ -172,15 +532,11 @@ tree_done(tree_t *t)
 	tree_done_node(t, t->ltree_white);
 
 	if (t->htable) free(t->htable);
-	if (t->nodes) {
-		free(t->nodes);
-		free(t);
-	} else if (!tree_done_node(t, t->root)) {
-		free(t);
-		/* A tree_done_node_worker might still be running on this tree but
-		 * it will free the tree later. It is also freeing nodes faster than
-		 * we will create new ones. */
-	}
+	if (t->tt) tree_tt_done(t->tt);
+	if (t->gc) tree_gc_done(t->gc);
+	if (t->nodes) tree_free_buffer(t);
+	if (t->arena) tree_arena_done_detached(t->arena);
+	free(t);
 }
 
 
@@ -193,29 +549,29 @@ tree_node_dump(tree_t *tree, tree_node_t *node, int treeparity, int l, int thres
 		children++;
 	/* We use 1 as parity, since for all nodes we want to know the
 	 * win probability of _us_, not the node color. */
-	fprintf(stderr, "[%s] %.3f/%d [prior %.3f/%d amaf %.3f/%d crit %.3f vloss %d] h=%x c#=%d <%" PRIhash ">\n",
+	fprintf(stderr, "[%s] %.3f/%d [prior %.3f/%d amaf %.3f/%d crit %.3f vloss %d] h=%x c#=%d <%p>\n",
 		coord2sstr(node_coord(node)),
-		tree_node_get_value(tree, treeparity, node->u.value), node->u.playouts,
-		tree_node_get_value(tree, treeparity, node->prior.value), node->prior.playouts,
-		tree_node_get_value(tree, treeparity, node->amaf.value), node->amaf.playouts,
+		tree_node_get_value(tree, treeparity, node_u(node).value), node_u(node).playouts,
+		tree_node_get_value(tree, treeparity, node_prior(node).value), node_prior(node).playouts,
+		tree_node_get_value(tree, treeparity, node_amaf(node).value), node_amaf(node).playouts,
 		tree_node_criticality(tree, node), node->descents,
-		node->hints, children, node->hash);
+		node->hints, children, node);
 
 	/* Print nodes sorted by #playouts. */
 
 	tree_node_t *nbox[1000]; int nboxl = 0;
 	for (tree_node_t *ni = node->children; ni; ni = ni->sibling)
-		if (ni->u.playouts > thres)
+		if (node_u(ni).playouts > thres)
 			nbox[nboxl++] = ni;
 
 	while (true) {
 		int best = -1;
 		for (int i = 0; i < nboxl; i++)
-			if (nbox[i] && (best < 0 || nbox[i]->u.playouts > nbox[best]->u.playouts))
+			if (nbox[i] && (best < 0 || node_u(nbox[i]).playouts > node_u(nbox[best]).playouts))
 				best = i;
 		if (best < 0)
 			break;
-		tree_node_dump(tree, nbox[best], treeparity, l + 1, /* node->u.value < 0.1 ? 0 : */ thres);
+		tree_node_dump(tree, nbox[best], treeparity, l + 1, /* node_u(node).value < 0.1 ? 0 : */ thres);
 		nbox[best] = NULL;
 	}
 }
@@ -223,7 +579,7 @@ tree_node_dump(tree_t *tree, tree_node_t *node, int treeparity, int l, int thres
 void
 tree_dump(tree_t *tree, double thres)
 {
-	int thres_abs = thres > 0 ? tree->root->u.playouts * thres : thres;
+	int thres_abs = thres > 0 ? node_u(tree->root).playouts * thres : thres;
 	fprintf(stderr, "(UCT tree; root %s; extra komi %f; max depth %d)\n",
 	        stone2str(tree->root_color), tree->extra_komi,
 		tree->max_depth - tree->root->depth);
@@ -250,18 +606,33 @@ tree_book_name(board_t *b)
 	return buf;
 }
 
+/* Node fields saved/loaded from opening tbook, in file order. */
+#define tree_node_record(node, io) do { \
+		io(&node_u(node), sizeof(move_stats_t)); \
+		io(&node_prior(node), sizeof(move_stats_t)); \
+		io(&node_amaf(node), sizeof(move_stats_t)); \
+		io(&(node)->pu, sizeof(move_stats_t)); \
+		io(&(node)->winner_owner, sizeof(move_stats_t)); \
+		io(&(node)->black_owner, sizeof(move_stats_t)); \
+		io(&(node)->coord, sizeof((node)->coord)); \
+		io(&(node)->depth, sizeof((node)->depth)); \
+		io(&(node)->descents, sizeof((node)->descents)); \
+		io(&(node)->d, sizeof((node)->d)); \
+		io(&(node)->hints, sizeof((node)->hints)); \
+		io(&(node)->is_expanded, sizeof((node)->is_expanded)); \
+	} while (0)
+
 static void
 tree_node_save(FILE *f, tree_node_t *node, int thres)
 {
-	bool save_children = node->u.playouts >= thres;
+	bool save_children = node_u(node).playouts >= thres;
 
 	if (!save_children)
 		node->is_expanded = 0;
 
 	fputc(1, f);
-	fwrite(((int *) node) + offsetof(tree_node_t, u),
-	       sizeof(tree_node_t) - offsetof(tree_node_t, u),
-	       1, f);
+#define node_write(ptr, size)  fwrite(ptr, size, 1, f)
+	tree_node_record(node, node_write);
 
 	if (save_children) {
 		for (tree_node_t *ni = node->children; ni; ni = ni->sibling)
@@ -289,35 +660,59 @@ tree_save(tree_t *tree, board_t *b, int thres)
 }
 
 
-void
-tree_node_load(FILE *f, tree_node_t *node, int *num)
+/* Load node data and its subtree. Children are first loaded in a temporary
+ * buffer, then moved to a single block once we know how many there are. */
+static void
+tree_node_load(FILE *f, tree_t *t, tree_node_t *node, int *num)
 {
 	(*num)++;
 
-	checked_fread(((int *) node) + offsetof(tree_node_t, u),
-		      sizeof(tree_node_t) - offsetof(tree_node_t, u),
-		      1, f);
+#define node_read(ptr, size)  checked_fread(ptr, size, 1, f)
+	tree_node_record(node, node_read);
+	node->hints &= ~TREE_HINT_PENDING;  /* Only saved children are loaded. */
 
 	/* Keep values in sane scale, otherwise we start overflowing. */
 #define MAX_PLAYOUTS	10000000
-	if (node->u.playouts > MAX_PLAYOUTS) {
-		node->u.playouts = MAX_PLAYOUTS;
+	if (node_u(node).playouts > MAX_PLAYOUTS) {
+		node_u(node).playouts = MAX_PLAYOUTS;
 	}
-	if (node->amaf.playouts > MAX_PLAYOUTS) {
-		node->amaf.playouts = MAX_PLAYOUTS;
+	if (node_amaf(node).playouts > MAX_PLAYOUTS) {
+		node_amaf(node).playouts = MAX_PLAYOUTS;
 	}
-	memcpy(&node->pu, &node->u, sizeof(node->u));
+	memcpy(&node->pu, &node_u(node), sizeof(node_u(node)));
 
-	tree_node_t *ni = NULL, *ni_prev = NULL;
+	/* Temporary single-node blocks. */
+	size_t tsize = tree_block_size(1);
+	char *tmp = NULL;
+	int count = 0;
 	while (fgetc(f)) {
-		ni_prev = ni; ni = calloc2(1, tree_node_t);
-		if (!node->children)
-			node->children = ni;
-		else
-			ni_prev->sibling = ni;
-		ni->parent = node;
-		tree_node_load(f, ni, num);
+		tmp = realloc(tmp, (count + 1) * tsize);
+		if (!tmp) fail("realloc");
+		tree_node_t *ni = (tree_node_t *)(tmp + count++ * tsize);
+		memset(ni, 0, tsize);
+		ni->count = 1;
+		tree_node_load(f, t, ni, num);
 	}
+	if (!count)
+		return;
+
+	tree_node_t *first = tree_alloc_node(t, count, false);
+	if (!first) {
+		/* Out of memory in fast_alloc mode: drop the children. */
+		node->is_expanded = false;
+		free(tmp);
+		return;
+	}
+	for (int i = 0; i < count; i++) {
+		tree_node_t *nj = first + i;
+		tree_copy_node(nj, (tree_node_t *)(tmp + i * tsize));
+		nj->parent = node;
+		nj->sibling = (i < count - 1 ? nj + 1 : NULL);
+		for (tree_node_t *nk = nj->children; nk; nk = nk->sibling)
+			nk->parent = nj;
+	}
+	free(tmp);
+	node->children = first;
 }
 
 void
@@ -332,58 +727,75 @@ tree_load(tree_t *tree, board_t *b)
 
 	int num = 0;
 	if (fgetc(f))
-		tree_node_load(f, tree->root, &num);
+		tree_node_load(f, tree, tree->root, &num);
 	fprintf(stderr, "Loaded %d nodes.\n", num);
 
 	fclose(f);
 }
 
 
-/* Copy the subtree rooted at node: all nodes at or below depth
- * or with at least threshold playouts. Only for fast_alloc.
- * The code is destructive on src. The relative order of children of
- * a given node is preserved (assumed by tree_get_node in particular).
- * Returns the copy of node in the destination tree, or NULL
- * if we could not copy it. */
-static tree_node_t *
-tree_prune(tree_t *dest, tree_t *src, tree_node_t *node,
-	   int threshold, int depth)
+/* Copy the children of node below n2, its copy in the destination tree:
+ * all nodes at or below depth or with at least threshold playouts.
+ * Children are copied as a single block, preserving their relative
+ * order (assumed by tree_get_node in particular). */
+static void
+tree_prune_children(tree_t *dest, tree_t *src, tree_node_t *node, tree_node_t *n2,
+		    int threshold, int depth)
 {
-	assert(dest->nodes && node);
-	tree_node_t *n2 = tree_alloc_node(dest, 1, true);
-	if (!n2)
-		return NULL;
-	*n2 = *node;
-	if (n2->depth > dest->max_depth)
-		dest->max_depth = n2->depth;
 	n2->children = NULL;
 	n2->is_expanded = false;
 
-	if (node->depth >= depth && node->u.playouts < threshold)
-		return n2;
+	if (node->depth >= depth && node_u(node).playouts < threshold)
+		return;
 	/* For deep nodes with many playouts, we must copy all children,
 	 * even those with zero playouts, because partially expanded
 	 * nodes are not supported. Considering them as fully expanded
 	 * would degrade the playing strength. The only exception is
 	 * when dest becomes full, but this should never happen in practice
 	 * if threshold is chosen to limit the number of nodes traversed. */
+	int count = 0;
+	for (tree_node_t *ni = node->children; ni; ni = ni->sibling)
+		count++;
+	if (!count)
+		return;
+	tree_node_t *first = tree_alloc_children_copy(dest, node, count);
+	if (!first)
+		return; // avoid partially expanded nodes
+
 	tree_node_t *ni = node->children;
-	if (!ni)
-		return n2;
-	tree_node_t **prev2 = &(n2->children);
-	while (ni) {
-		tree_node_t *ni2 = tree_prune(dest, src, ni, threshold, depth);
-		if (!ni2) break;
-		*prev2 = ni2;
-		prev2 = &(ni2->sibling);
+	for (int i = 0; i < count; i++, ni = ni->sibling) {
+		tree_node_t *ni2 = first + i;
+		tree_copy_node(ni2, ni);
 		ni2->parent = n2;
-		ni = ni->sibling;
-	}
-	if (!ni) {
-		n2->is_expanded = true;
-	} else {
-		n2->children = NULL; // avoid partially expanded nodes
+		ni2->sibling = (i < count - 1 ? ni2 + 1 : NULL);
+		if (ni2->depth > dest->max_depth)
+			dest->max_depth = ni2->depth;
 	}
+	tree_copy_pending(n2, first, node, count);
+	ni = node->children;
+	for (int i = 0; i < count; i++, ni = ni->sibling)
+		tree_prune_children(dest, src, ni, first + i, threshold, depth);
+
+	n2->children = first;
+	n2->is_expanded = true;
+}
+
+/* Copy the subtree rooted at node: all nodes at or below depth
+ * or with at least threshold playouts.
+ * Returns the copy of node in the destination tree, or NULL
+ * if we could not copy it. */
+static tree_node_t *
+tree_prune(tree_t *dest, tree_t *src, tree_node_t *node,
+	   int threshold, int depth)
+{
+	assert(node);
+	tree_node_t *n2 = tree_alloc_node(dest, 1, false);
+	if (!n2)
+		return NULL;
+	tree_copy_node(n2, node);
+	if (n2->depth > dest->max_depth)
+		dest->max_depth = n2->depth;
+	tree_prune_children(dest, src, node, n2, threshold, depth);
 	return n2;
 }
 
@@ -408,27 +820,16 @@ tree_prune(tree_t *dest, tree_t *src, tree_node_t *node,
  * This guarantees garbage collection in < 1s. */
 #define SMALL_TREE_PLAYOUTS 5000
 
-/* Free all the tree, keeping only the subtree rooted at node.
- * Prune the subtree if necessary to fit in memory or
- * to save time scanning the tree.
- * Returns the moved node. Only for fast_alloc. */
-tree_node_t *
-tree_garbage_collect(tree_t *tree, tree_node_t *node)
+/* Pick which nodes to keep when copying the subtree rooted at node
+ * to a max_pruned_size buffer, see tree_prune(). */
+static void
+tree_prune_limits(tree_t *tree, tree_node_t *node, int *threshold_, int *max_depth_)
 {
-	assert(tree->nodes && !node->parent && !node->sibling);
-	double start_time = time_now();
-	size_t orig_size = tree->nodes_size;
-
-	tree_t *temp_tree = tree_init(tree->board,  tree->root_color,
-					   tree->max_pruned_size, 0, 0, tree->ltree_aging, 0);
-	temp_tree->nodes_size = 0; // We do not want the dummy pass node
-        tree_node_t *temp_node;
-
 	/* Find the maximum depth at which we can copy all nodes. */
 	int max_nodes = 1;
 	for (tree_node_t *ni = node->children; ni; ni = ni->sibling)
 		max_nodes++;
-	size_t nodes_size = max_nodes * sizeof(*node);
+	size_t nodes_size = tree_block_size(max_nodes);
 	int max_depth = node->depth;
 	while (nodes_size < tree->max_pruned_size && max_nodes > 1) {
 		max_nodes--;
@@ -442,16 +843,257 @@ tree_garbage_collect(tree_t *tree, tree_node_t *node)
 	 * to save time scanning the source tree. It can take over 20s to traverse
 	 * completely a large source tree (20 GB) even without copying because
 	 * the traversal is not friendly at all with the memory cache. */
-	int threshold = (node->u.playouts - LARGE_TREE_PLAYOUTS) * DEEP_PLAYOUTS_THRESHOLD / LARGE_TREE_PLAYOUTS;
+	int threshold = (node_u(node).playouts - LARGE_TREE_PLAYOUTS) * DEEP_PLAYOUTS_THRESHOLD / LARGE_TREE_PLAYOUTS;
 	if (threshold < 0) threshold = 0;
 	if (threshold > DEEP_PLAYOUTS_THRESHOLD) threshold = DEEP_PLAYOUTS_THRESHOLD; 
-	temp_node = tree_prune(temp_tree, tree, node, threshold, max_depth);
+	*threshold_ = threshold;
+	*max_depth_ = max_depth;
+}
+
+/* Concurrent garbage collection (fast_alloc only).
+ * tree_garbage_collect() stops the world while it scans the source tree,
+ * which can take seconds on large trees right when we need to play.
+ * Instead, while the search runs a background thread keeps a pruned copy
+ * of the subtree under the root up to date in a max_pruned_size buffer:
+ * each pass refreshes the stats of nodes already copied and copies child
+ * blocks expanded since, so a pass can stop anywhere and leave a usable
+ * snapshot. At promotion the snapshot of the promoted node is copied back
+ * from the compact buffer, without scanning the big tree. Playouts made
+ * after the last pass are lost, this is cheaper than losing on time.
+ * Snapshots are tagged with the tree generation, which changes whenever
+ * nodes move (promotion, symmetry fix), and ignored if stale. */
+
+typedef struct tree_gc {
+	tree_t *tree;		/* Buffer for the snapshot */
+	tree_node_t *root;	/* Copy of the root in it, NULL if no snapshot yet */
+	unsigned int generation;
+	int threshold, max_depth;
+	bool full;		/* Snapshot overflowed, unusable */
+	volatile bool halt;
+	bool running;
+	pthread_t thread;
+
+	/* Statistics */
+	int passes;
+} tree_gc_t;
+
+/* Delay between two passes. */
+#define TREE_GC_INTERVAL 0.1
+
+struct tree_gc *
+tree_gc_init(tree_t *t)
+{
+	assert(t->nodes);
+	tree_gc_t *gc = calloc2(1, tree_gc_t);
+	gc->tree = tree_init(t->board, t->root_color, t->max_pruned_size, t->huge_pages, 0, 0, 1.0f, 0);
+	return gc;
+}
+
+void
+tree_gc_done(struct tree_gc *gc)
+{
+	assert(!gc->running);
+	tree_done(gc->tree);
+	free(gc);
+}
+
+/* Update copy s of node n, keeping its links in the snapshot. */
+static void
+tree_gc_copy_node(tree_node_t *s, tree_node_t *n)
+{
+	tree_node_t *parent = s->parent, *sibling = s->sibling, *children = s->children;
+	tree_copy_node(s, n);
+	s->parent = parent;
+	s->sibling = sibling;
+	s->children = children;
+	s->is_expanded = (children != NULL);
+	s->descents = 0;
+}
+
+/* Refresh the snapshot of the subtree rooted at n, s being its copy.
+ * Workers may be expanding nodes concurrently: a child block is only
+ * picked up once published (n->children set), and siblings within a
+ * block never change afterwards. */
+static void
+tree_gc_sync(tree_gc_t *gc, tree_node_t *s, tree_node_t *n)
+{
+	if (gc->halt)
+		return;
+	tree_gc_copy_node(s, n);
+
+	tree_node_t *children = n->children;
+	if (!children)
+		return;
+	int count = 0;
+	for (tree_node_t *ni = children; ni; ni = ni->sibling)
+		count++;
+
+	if (!s->children) {
+		if (gc->full || (s->depth >= gc->max_depth && node_u(n).playouts < gc->threshold))
+			return;
+		tree_node_t *first = tree_alloc_children_copy(gc->tree, n, count);
+		if (!first) {
+			gc->full = true;
+			return;
+		}
+		tree_node_t *ni = children;
+		for (int i = 0; i < count; i++, ni = ni->sibling) {
+			tree_node_t *si = first + i;
+			si->parent = s;
+			si->sibling = (i < count - 1 ? si + 1 : NULL);
+			tree_gc_copy_node(si, ni);
+			if (si->depth > gc->tree->max_depth)
+				gc->tree->max_depth = si->depth;
+		}
+		tree_copy_pending(s, first, n, count);
+		s->children = first;
+		s->is_expanded = true;
+	} else if (s->children->count > count)
+		return;  /* Not a block we copied, shouldn't happen. */
+	/* Children widened since the copy are still pending in the snapshot. */
+
+	tree_node_t *si = s->children, *ni = children;
+	for (; si; si = si->sibling, ni = ni->sibling)
+		tree_gc_sync(gc, si, ni);
+}
+
+static void *
+tree_gc_worker(void *data)
+{
+	tree_t *t = (tree_t*)data;
+	tree_gc_t *gc = t->gc;
+
+	while (!gc->halt) {
+		/* Only worth it if promotion would garbage collect. */
+		if (t->nodes_size >= t->max_tree_size / 10) {
+			tree_prune_limits(t, t->root, &gc->threshold, &gc->max_depth);
+			tree_gc_sync(gc, gc->root, t->root);
+			gc->passes++;
+		}
+		time_sleep(TREE_GC_INTERVAL);
+	}
+	return NULL;
+}
+
+/* Start refreshing the snapshot in the background while searching. */
+void
+tree_gc_start(tree_t *t)
+{
+	tree_gc_t *gc = t->gc;
+	assert(!gc->running);
+	if (!gc->root || gc->generation != t->generation) {
+		gc->tree->nodes_size = 0;
+		gc->tree->max_depth = 0;
+		gc->root = tree_init_node(gc->tree, node_coord(t->root), t->root->depth, false);
+		gc->generation = t->generation;
+		gc->full = false;
+		gc->passes = 0;
+	}
+	gc->halt = false;
+	gc->running = true;
+	pthread_create(&gc->thread, NULL, tree_gc_worker, t);
+}
+
+/* Stop the gc thread, at most one node visit away. */
+void
+tree_gc_stop(tree_t *t)
+{
+	tree_gc_t *gc = t->gc;
+	if (!gc->running)
+		return;
+	gc->halt = true;
+	pthread_join(gc->thread, NULL);
+	gc->running = false;
+}
+
+/* Garbage collect from the snapshot if there is a usable one for node,
+ * which is either the root or one of its children.
+ * Returns the moved node, or NULL. */
+static tree_node_t *
+tree_gc_restore(tree_t *tree, tree_node_t *node)
+{
+	tree_gc_t *gc = tree->gc;
+	assert(!gc->running);
+	if (!gc->root || gc->generation != tree->generation || gc->full)
+		return NULL;
+	tree_node_t *s = gc->root;
+	if (node != tree->root) {
+		s = gc->root->children;
+		while (s && node_coord(s) != node_coord(node))
+			s = s->sibling;
+		if (!s)
+			return NULL;
+	}
+
+	double start_time = time_now();
+	size_t orig_size = tree->nodes_size;
+	int playouts = node_u(node).playouts;
+
+	tree->nodes_size = 0;
+	tree->max_depth = 0;
+	tree_node_t *new_node = tree_prune(tree, gc->tree, s, 0, INT_MAX);
+	new_node->parent = new_node->sibling = NULL;
+
+	if (DEBUGL(1))
+		fprintf(stderr, "tree restored from snapshot in %0.3fs after %d passes,"
+			" size %llu->%llu, playouts %d->%d\n",
+			time_now() - start_time, gc->passes,
+			(unsigned long long)orig_size, (unsigned long long)tree->nodes_size,
+			playouts, node_u(new_node).playouts);
+	return new_node;
+}
+
+/* Prune the subtree rooted at node (see tree_prune()) into the
+ * max_pruned_size temp tree, then copy it back to the start of the
+ * nodes buffer. Returns the moved node, temp tree in *temp_tree
+ * (caller must free it unless it's the gc snapshot buffer). */
+static tree_node_t *
+tree_prune_in_place(tree_t *tree, tree_node_t *node, int threshold, int max_depth, tree_t **temp_tree)
+{
+	tree_t *temp;
+	if (tree->gc) {  /* Reuse the snapshot buffer */
+		temp = tree->gc->tree;
+		temp->max_depth = 0;
+		tree->gc->root = NULL;
+	} else
+		temp = tree_init(tree->board,  tree->root_color, tree->max_pruned_size,
+				 tree->huge_pages, 0, 0, tree->ltree_aging, 0);
+	temp->nodes_size = 0; // We do not want the dummy pass node
+
+	tree_node_t *temp_node = tree_prune(temp, tree, node, threshold, max_depth);
 	assert(temp_node);
 
 	/* Now copy back to original tree. */
 	tree->nodes_size = 0;
 	tree->max_depth = 0;
-	tree_node_t *new_node = tree_prune(tree, temp_tree, temp_node, 0, temp_tree->max_depth);
+	*temp_tree = temp;
+	return tree_prune(tree, temp, temp_node, 0, temp->max_depth);
+}
+
+/* Free all the tree, keeping only the subtree rooted at node.
+ * Prune the subtree if necessary to fit in memory or
+ * to save time scanning the tree. With concurrent gc, node is
+ * restored from the snapshot instead if possible.
+ * Returns the moved node. Only for fast_alloc. */
+tree_node_t *
+tree_garbage_collect(tree_t *tree, tree_node_t *node)
+{
+	assert(tree->nodes && !node->parent && !node->sibling);
+	if (tree->gc) {
+		tree_node_t *n = tree_gc_restore(tree, node);
+		if (n) {
+			tree->generation++;
+			if (tree->tt) tree_tt_clear(tree->tt);
+			return n;
+		}
+	}
+	double start_time = time_now();
+	size_t orig_size = tree->nodes_size;
+
+	int threshold, max_depth;
+	tree_prune_limits(tree, node, &threshold, &max_depth);
+	tree_t *temp_tree;
+	tree_node_t *new_node = tree_prune_in_place(tree, node, threshold, max_depth, &temp_tree);
 
 	if (DEBUGL(1)) {
 		double now = time_now();
@@ -461,7 +1103,7 @@ tree_garbage_collect(tree_t *tree, tree_node_t *node)
 			"tree pruned in %0.3fs, prev %0.1fs ago, dest depth %d wanted %d,"
 			" size %llu->%llu/%llu, playouts %d\n",
 			now - start_time, start_time - prev_time, temp_tree->max_depth, max_depth,
-			(unsigned long long)orig_size, (unsigned long long)temp_tree->nodes_size, (unsigned long long)tree->max_pruned_size, new_node->u.playouts);
+			(unsigned long long)orig_size, (unsigned long long)temp_tree->nodes_size, (unsigned long long)tree->max_pruned_size, node_u(new_node).playouts);
 		prev_time = start_time;
 	}
 	if (temp_tree->nodes_size >= temp_tree->max_tree_size) {
@@ -473,10 +1115,77 @@ tree_garbage_collect(tree_t *tree, tree_node_t *node)
 		assert(tree->nodes_size == temp_tree->nodes_size);
 		assert(tree->max_depth == temp_tree->max_depth);
 	}
-	tree_done(temp_tree);
+	if (!tree->gc)  tree_done(temp_tree);
+	tree->generation++;
+	if (tree->tt) tree_tt_clear(tree->tt);
 	return new_node;
 }
 
+/* Node recycling: when the tree gets full while searching, discard the
+ * least visited subtrees so search can go on with bounded memory.
+ * Nodes are bucketed by playouts (powers of two) along with the size of
+ * their children block, and children are kept only for nodes above the
+ * lowest playouts threshold that fits in max_pruned_size. Discarded
+ * nodes get expanded again if search comes back to them. */
+
+#define TREE_RECYCLE_BUCKETS 32
+
+/* Children block size of node and its descendants, by node playouts:
+ * bucket k > 0 holds playouts in [2^(k-1), 2^k). */
+static void
+tree_recycle_scan(tree_node_t *node, size_t *sizes)
+{
+	if (!node->children)
+		return;
+	int count = 0;
+	for (tree_node_t *ni = node->children; ni; ni = ni->sibling) {
+		tree_recycle_scan(ni, sizes);
+		count++;
+	}
+	size_t size = tree_block_size(count);
+	if (tree_node_has_pending(node))
+		size += tree_pending_size(tree_node_pending(node)->count);
+	int playouts = node_u(node).playouts;
+	int k = (playouts > 0 ? 32 - __builtin_clz(playouts) : 0);
+	sizes[k] += size;
+}
+
+tree_node_t *
+tree_recycle(tree_t *tree)
+{
+	tree_node_t *root = tree->root;
+	assert(tree->nodes && !root->parent && !root->sibling);
+	double start_time = time_now();
+	size_t orig_size = tree->nodes_size;
+
+	size_t sizes[TREE_RECYCLE_BUCKETS + 1];
+	memset(sizes, 0, sizeof(sizes));
+	tree_recycle_scan(root, sizes);
+
+	/* Root children are always kept. */
+	size_t total = tree_block_size(1);
+	int k;
+	for (k = TREE_RECYCLE_BUCKETS; k >= 0; k--) {
+		if (total + sizes[k] > tree->max_pruned_size)
+			break;
+		total += sizes[k];
+	}
+	int threshold = (k < 0 ? 0 : 1 << k);
+
+	tree_t *temp_tree;
+	tree_node_t *new_root = tree_prune_in_place(tree, root, threshold, root->depth + 1, &temp_tree);
+	new_root->parent = new_root->sibling = NULL;
+	if (!tree->gc)  tree_done(temp_tree);
+	tree->generation++;
+	if (tree->tt) tree_tt_clear(tree->tt);
+
+	if (DEBUGL(2))
+		fprintf(stderr, "tree recycled in %0.3fs, threshold %d playouts, size %llu->%llu\n",
+			time_now() - start_time, threshold,
+			(unsigned long long)orig_size, (unsigned long long)tree->nodes_size);
+	return new_root;
+}
+
 /* Find node of given coordinate under parent.
  * FIXME: Adjust for board symmetry. */
 tree_node_t *
@@ -501,7 +1210,7 @@ tree_get_node2(tree_t *t, tree_node_t *parent, coord_t c, bool create)
 		if (!create)
 			return NULL;
 
-		tree_node_t *nn = tree_init_node(t, c, parent->depth + 1, false);
+		tree_node_t *nn = tree_init_node(t, c, parent->depth + 1, true);
 		nn->parent = parent; nn->sibling = parent->children;
 		parent->children = nn;
 		return nn;
@@ -520,7 +1229,7 @@ tree_get_node2(tree_t *t, tree_node_t *parent, coord_t c, bool create)
 	if (!create)
 		return NULL;
 
-	tree_node_t *nn = tree_init_node(t, c, parent->depth + 1, false);
+	tree_node_t *nn = tree_init_node(t, c, parent->depth + 1, true);
 	nn->parent = parent; nn->sibling = ni->sibling; ni->sibling = nn;
 	return nn;
 }
@@ -566,6 +1275,208 @@ tree_lnode_for_node(tree_t *tree, tree_node_t *ni, tree_node_t *lni, int tenuki_
 	return NULL;
 }
 
+bool
+tree_solver_update(tree_t *tree, tree_node_t *node)
+{
+	/* Parent is proven if a child move wins for the color to play,
+	 * or if all children are proven (best result then). Black
+	 * maximizes proven value, white minimizes it. */
+	for (tree_node_t *p = node->parent; p; p = p->parent) {
+		if (p->proven)  return false;
+		enum stone color = tree_node_children_color(tree, p);
+		int win = proven_win(color);
+		int best = PROVEN_NONE;
+		/* Pending moves (progressive widening) aren't proven. */
+		bool all_proven = !(tree_node_has_pending(p) && tree_node_pending(p)->left);
+		for (tree_node_t *ni = p->children; ni; ni = ni->sibling) {
+			if (ni->hints & TREE_HINT_INVALID)  continue;
+			if (ni->proven == win) {  best = win;  all_proven = true;  break;  }
+			if (!ni->proven)       {  all_proven = false;  continue;  }
+			if (!best || (color == S_BLACK ? ni->proven > best : ni->proven < best))
+				best = ni->proven;
+		}
+		if (!all_proven || !best)  return false;
+		p->proven = best;
+	}
+	return true;
+}
+
+/* Prior strength of a move, for progressive widening. */
+#define prior_wins(s)  ((s).value * (s).playouts)
+
+void
+tree_widen_node(tree_t *t, tree_node_t *node, int n)
+{
+	tree_pending_t *p = tree_node_pending(node);
+	if (__sync_lock_test_and_set(&p->lock, 1))
+		return;  /* Another thread is on it. */
+	if (n > p->left)  n = p->left;
+	if (n <= 0)  goto done;
+
+	/* Pick best pending priors. */
+	int best[BOARD_MAX_MOVES];
+	for (int k = 0; k < n; k++) {
+		int b = -1;
+		for (int i = 0; i < p->count; i++) {
+			if (p->move[i].taken)  continue;
+			if (b < 0 || prior_wins(p->move[i].prior) > prior_wins(p->move[b].prior))
+				b = i;
+		}
+		best[k] = b;
+		p->move[b].taken = true;
+	}
+
+	tree_node_t *first = tree_alloc_node(t, n, false);
+	if (!first) {  /* fast_alloc: out of memory */
+		for (int k = 0; k < n; k++)
+			p->move[best[k]].taken = false;
+		goto done;
+	}
+
+	/* Keep coord order within the block. */
+	for (int k = 1; k < n; k++)
+		for (int j = k; j > 0 && best[j] < best[j - 1]; j--) {
+			int tmp = best[j];  best[j] = best[j - 1];  best[j - 1] = tmp;
+		}
+
+	move_stats_t *prior = tree_block_prior(first);
+	for (int k = 0; k < n; k++) {
+		tree_pending_move_t *m = &p->move[best[k]];
+		tree_node_t *ni = first + k;
+		tree_setup_node(t, ni, m->coord, node->depth + 1);
+		ni->parent = node;
+		ni->sibling = (k < n - 1 ? ni + 1 : NULL);
+		ni->d = m->d;
+		prior[k] = m->prior;
+	}
+	p->left -= n;
+	p->children += n;
+
+	/* Publish the new block at the end of the children list. */
+	__sync_synchronize();
+	p->last->sibling = first;
+	p->last = first + n - 1;
+
+ done:
+	__sync_lock_release(&p->lock);
+}
+
+
+/* Transposition seeding: the same position is often reached through
+ * different move orders. Nodes are not shared between them (the tree relies
+ * on parent pointers), instead the first node expanded in a position is
+ * recorded in a lock-free hash table, and nodes expanded later in the same
+ * position start with a snapshot of its children's statistics: their u stats
+ * seed the priors and amaf stats are carried over, capped at tt_seed_eqex
+ * playouts. This happens once at expansion, stats are not kept in sync. */
+
+typedef struct {
+	hash_t hash;		/* 0 if entry is free */
+	tree_node_t *node;	/* NULL until inserting thread sets it */
+} tree_tt_entry_t;
+
+typedef struct tree_tt {
+	int bits;
+	tree_tt_entry_t *table;
+
+	/* Statistics */
+	int lookups, seeded, entries, full;
+} tree_tt_t;
+
+/* Number of slots tried before giving up on an entry. */
+#define TREE_TT_PROBES 8
+
+struct tree_tt *
+tree_tt_init(int bits)
+{
+	tree_tt_t *tt = calloc2(1, tree_tt_t);
+	tt->bits = bits;
+	tt->table = calloc2(1 << bits, tree_tt_entry_t);
+	return tt;
+}
+
+void
+tree_tt_done(struct tree_tt *tt)
+{
+	free(tt->table);
+	free(tt);
+}
+
+void
+tree_tt_clear(struct tree_tt *tt)
+{
+	memset(tt->table, 0, (1 << tt->bits) * sizeof(tree_tt_entry_t));
+	tt->lookups = tt->seeded = tt->entries = tt->full = 0;
+}
+
+void
+tree_tt_print_stats(tree_t *t)
+{
+	tree_tt_t *tt = t->tt;
+	fprintf(stderr, "(transposition seeding: %d/%d expansions seeded (%.1f%%), %d entries, %d full)\n",
+		tt->seeded, tt->lookups, tt->lookups ? tt->seeded * 100.0 / tt->lookups : 0.0,
+		tt->entries, tt->full);
+}
+
+/* Position key, 0 is reserved for free entries. */
+static hash_t
+tree_tt_key(board_t *b, enum stone color)
+{
+	hash_t key = b->hash ^ (color == S_WHITE ? 0x9e3779b97f4a7c15ULL : 0);
+	return (key ? key : 1);
+}
+
+/* Find node expanded in the same position, NULL if none. */
+static tree_node_t *
+tree_tt_lookup(tree_tt_t *tt, hash_t key)
+{
+	__sync_fetch_and_add(&tt->lookups, 1);
+	int mask = (1 << tt->bits) - 1;
+	for (int i = 0; i < TREE_TT_PROBES; i++) {
+		tree_tt_entry_t *e = &tt->table[(key + i) & mask];
+		if (!e->hash)
+			return NULL;
+		if (e->hash == key) {
+			tree_node_t *n = e->node;
+			if (n && n->children)  __sync_fetch_and_add(&tt->seeded, 1);
+			return n;
+		}
+	}
+	return NULL;
+}
+
+/* Record node as the first one expanded in its position. */
+static void
+tree_tt_insert(tree_tt_t *tt, hash_t key, tree_node_t *node)
+{
+	int mask = (1 << tt->bits) - 1;
+	for (int i = 0; i < TREE_TT_PROBES; i++) {
+		tree_tt_entry_t *e = &tt->table[(key + i) & mask];
+		if (e->hash == key)  /* Some other thread was faster. */
+			return;
+		if (!e->hash && __sync_bool_compare_and_swap(&e->hash, 0, key)) {
+			e->node = node;
+			__sync_fetch_and_add(&tt->entries, 1);
+			return;
+		}
+	}
+	__sync_fetch_and_add(&tt->full, 1);
+}
+
+/* Merge stats of transposed node's children into the new children's. */
+static void
+tree_tt_seed(tree_node_t *tnode, move_stats_t *prior, move_stats_t *amaf, int eqex)
+{
+	for (tree_node_t *ni = tnode->children; ni; ni = ni->sibling) {
+		coord_t c = node_coord(ni);
+		move_stats_t u = node_u(ni), a = node_amaf(ni);
+		if (u.playouts > eqex)  u.playouts = eqex;
+		if (a.playouts > eqex)  a.playouts = eqex;
+		if (u.playouts > 0)  stats_merge(&prior[c], &u);
+		if (a.playouts > 0)  stats_merge(&amaf[c], &a);
+	}
+}
+
 
 /* Tree symmetry: When possible, we will localize the tree to a single part
  * of the board in tree_expand_node() and possibly flip along symmetry axes
@@ -573,6 +1484,40 @@ tree_lnode_for_node(tree_t *tree, tree_node_t *ni, tree_node_t *lni, int tenuki_
  * guidelines here. */
 
 
+static int
+cmp_floating_desc(const void *a, const void *b)
+{
+	floating_t x = *(const floating_t *)a, y = *(const floating_t *)b;
+	return (x < y) - (x > y);
+}
+
+/* Keep the @keep best moves of @children by prior (pass stays first),
+ * move the others to @pending. Children order is preserved. */
+static void
+tree_widening_split(int keep, coord_t *children, int *nchildren, coord_t *pending, int *npending, move_stats_t *prior)
+{
+	int n = *nchildren;
+	floating_t wins[n];
+	for (int k = 1; k < n; k++)
+		wins[k - 1] = prior_wins(prior[children[k]]);
+	qsort(wins, n - 1, sizeof(*wins), cmp_floating_desc);
+	floating_t thres = wins[keep - 1];
+	int equal = keep;	/* Ties at threshold we can take. */
+	for (int k = 0; k < keep; k++)
+		if (wins[k] > thres)  equal--;
+
+	int nc = 1;
+	for (int k = 1; k < n; k++) {
+		coord_t c = children[k];
+		floating_t w = prior_wins(prior[c]);
+		if (w > thres || (w == thres && equal-- > 0))
+			children[nc++] = c;
+		else
+			pending[(*npending)++] = c;
+	}
+	*nchildren = nc;
+}
+
 /* This function must be thread safe, given that board b is only modified by the calling thread. */
 void
 tree_expand_node(tree_t *t, tree_node_t *node, board_t *b, enum stone color, uct_t *u, int parity)
@@ -602,18 +1547,17 @@ tree_expand_node(tree_t *t, tree_node_t *node, board_t *b, enum stone color, uct
 	} foreach_free_point_end;
 	uct_prior(u, node, &map);
 
-	/* Now, create the nodes (all at once if fast_alloc) */
-	tree_node_t *ni = t->nodes ? tree_alloc_node(t, child_count, true) : tree_alloc_node(t, 1, false);
-	/* In fast_alloc mode we might temporarily run out of nodes but this should be rare. */
-	if (!ni) {
-		node->is_expanded = false;
-		return;
+	/* Seed statistics from transposed node, if any.
+	 * Positions with a ko are not shared, ko status is not part of the hash. */
+	move_stats_t map_amaf[board_max_coords(b) + 1];       memset(map_amaf, 0, sizeof(map_amaf));
+	move_stats_t *tt_amaf = &map_amaf[1];
+	hash_t tt_key = 0;
+	if (t->tt && is_pass(b->ko.coord)) {
+		tt_key = tree_tt_key(b, color);
+		tree_node_t *tnode = tree_tt_lookup(t->tt, tt_key);
+		if (tnode && tnode->children)
+			tree_tt_seed(tnode, map.prior, tt_amaf, u->tt_seed_eqex);
 	}
-	tree_setup_node(t, ni, pass, node->depth + 1);
-
-	tree_node_t *first_child = ni;
-	ni->parent = node;
-	ni->prior = map.prior[pass]; ni->d = TREE_NODE_D_MAX + 1;
 
 	/* The loop considers only the symmetry playground. */
 	if (UDEBUGL(6)) {
@@ -623,7 +1567,9 @@ tree_expand_node(tree_t *t, tree_node_t *node, board_t *b, enum stone color, uct
 				b->symmetry.x2, b->symmetry.y2,
 				b->symmetry.type, b->symmetry.d);
 	}
-	int child = 1;
+	coord_t children[child_count];
+	int nchildren = 0;
+	children[nchildren++] = pass;
 	for (int j = b->symmetry.y1; j <= b->symmetry.y2; j++) {
 		for (int i = b->symmetry.x1; i <= b->symmetry.x2; i++) {
 			if (b->symmetry.d) {
@@ -639,16 +1585,60 @@ tree_expand_node(tree_t *t, tree_node_t *node, board_t *b, enum stone color, uct
 			if (!map.consider[c]) // Filter out invalid moves
 				continue;
 			assert(c != node_coord(node)); // I have spotted "C3 C3" in some sequence...
+			children[nchildren++] = c;
+		}
+	}
 
-			tree_node_t *nj = t->nodes ? first_child + child++ : tree_alloc_node(t, 1, false);
-			tree_setup_node(t, nj, c, node->depth + 1);
-			nj->parent = node; ni->sibling = nj; ni = nj;
+	/* Progressive widening: only create children for the best priors
+	 * (and pass), other moves are kept pending. */
+	coord_t pending[nchildren];
+	int npending = 0;
+	if (u->widening && nchildren - 1 > u->widening)
+		tree_widening_split(u->widening, children, &nchildren, pending, &npending, map.prior);
 
-			ni->prior = map.prior[c];
-			ni->d = distances[c];
-		}
+	/* Now, create the nodes, all at once. */
+	size_t pending_size = (npending ? tree_pending_size(npending) : 0);
+	tree_node_t *first_child = tree_alloc_block(t, nchildren, pending_size, false);
+	/* In fast_alloc mode we might temporarily run out of nodes but this should be rare. */
+	if (!first_child) {
+		node->is_expanded = false;
+		return;
+	}
+
+	move_stats_t *prior = tree_block_prior(first_child);
+	move_stats_t *amaf = tree_block_amaf(first_child);
+	for (int k = 0; k < nchildren; k++) {
+		coord_t c = children[k];
+		tree_node_t *ni = first_child + k;
+		tree_setup_node(t, ni, c, node->depth + 1);
+		ni->parent = node;
+		ni->sibling = (k < nchildren - 1 ? ni + 1 : NULL);
+		ni->d = (is_pass(c) ? TREE_NODE_D_MAX + 1 : distances[c]);
+		prior[k] = map.prior[c];
+		amaf[k] = tt_amaf[c];
 	}
+	if (npending) {
+		tree_pending_t *p = tree_block_pending(first_child);
+		p->children = nchildren;
+		p->last = first_child + nchildren - 1;
+		p->left = p->count = npending;
+		for (int k = 0; k < npending; k++) {
+			coord_t c = pending[k];
+			p->move[k].coord = c;
+			p->move[k].d = distances[c];
+			p->move[k].prior = map.prior[c];
+		}
+		node->hints |= TREE_HINT_PENDING;
+	} else
+		node->hints &= ~TREE_HINT_PENDING;
 	node->children = first_child; // must be done at the end to avoid race
+
+	if (tt_key)
+		tree_tt_insert(t->tt, tt_key, node);
+
+	/* Root priors are dcnn evaluated synchronously, others asynchronously. */
+	if (u->tree_ready)
+		dcnn_queue_submit(u, t, node, b, color, parity);
 }
 
 
@@ -670,6 +1660,12 @@ tree_fix_node_symmetry(board_t *b, tree_node_t *node,
 	if (!is_pass(node_coord(node)))
 		node->coord = flip_coord(b, node_coord(node), flip_horiz, flip_vert, flip_diag);
 
+	if (tree_node_has_pending(node)) {
+		tree_pending_t *p = tree_node_pending(node);
+		for (int i = 0; i < p->count; i++)
+			p->move[i].coord = flip_coord(b, p->move[i].coord, flip_horiz, flip_vert, flip_diag);
+	}
+
 	for (tree_node_t *ni = node->children; ni; ni = ni->sibling)
 		tree_fix_node_symmetry(b, ni, flip_horiz, flip_vert, flip_diag);
 }
@@ -709,8 +1705,10 @@ tree_fix_symmetry(tree_t *tree, board_t *b, coord_t c)
 			coord2sstr(flip_coord(b, c, flip_horiz, flip_vert, flip_diag)),
 			s->type, s->d, b->symmetry.type, b->symmetry.d);
 	}
-	if (flip_horiz || flip_vert || flip_diag)
+	if (flip_horiz || flip_vert || flip_diag) {
 		tree_fix_node_symmetry(b, tree->root, flip_horiz, flip_vert, flip_diag);
+		tree->generation++;
+	}
 }
 
 
@@ -736,8 +1734,8 @@ tree_unlink_node(tree_node_t *node)
 static tree_node_t *
 tree_age_node(tree_t *tree, tree_node_t *node)
 {
-	node->u.playouts /= tree->ltree_aging;
-	if (node->parent && !node->u.playouts) {
+	node_u(node).playouts /= tree->ltree_aging;
+	if (node->parent && !node_u(node).playouts) {
 		tree_node_t *sibling = node->sibling;
 		/* Delete node, no playouts. */
 		tree_unlink_node(node);
@@ -750,25 +1748,27 @@ tree_age_node(tree_t *tree, tree_node_t *node)
 	return node->sibling;
 }
 
-/* Promotes the given node as the root of the tree. In the fast_alloc
- * mode, the node may be moved and some of its subtree may be pruned. */
+/* Promotes the given node as the root of the tree. The node may be
+ * moved, and in the fast_alloc mode some of its subtree may be pruned. */
 void
 tree_promote_node(tree_t *tree, tree_node_t **node)
 {
 	assert((*node)->parent == tree->root);
 	tree_unlink_node(*node);
 	if (!tree->nodes) {
-		/* Freeing the rest of the tree can take several seconds on large
-		 * trees, so we must do it asynchronously: */
-		tree_done_node_detached(tree, tree->root);
+		/* Subtree we keep stays in place, release chunks with
+		 * only the rest of the tree at once. */
+		tree->nodes_size = tree_arena_reclaim(tree->arena, *node);
 	} else {
 		/* Garbage collect if we run out of memory, or it is cheap to do so now: */
 		if (tree->nodes_size >= tree->pruning_threshold
-		    || (tree->nodes_size >= tree->max_tree_size / 10 && (*node)->u.playouts < SMALL_TREE_PLAYOUTS))
+		    || (tree->nodes_size >= tree->max_tree_size / 10 && node_u((*node)).playouts < SMALL_TREE_PLAYOUTS))
 			*node = tree_garbage_collect(tree, *node);
 	}
 	tree->root = *node;
+	tree->generation++;
 	tree->root_color = stone_other(tree->root_color);
+	if (tree->tt) tree_tt_clear(tree->tt);
 
 	board_symmetry_update(tree->board, &tree->root_symmetry, node_coord(*node));
 	tree->avg_score.playouts = 0;
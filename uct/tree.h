@@ -5,13 +5,13 @@
  *
  * Two allocation methods are supported for the tree nodes:
  *
- * - calloc/free: each node is allocated with one calloc.
- *   After a move, all nodes except the subtree rooted at
- *   the played move are freed one by one with free().
- *   Since this can be very slow (seen 9s and loss on time because
- *   of this) the nodes are freed in a background thread.
- *   We still reserve enough memory for the next move in case
- *   the background thread doesn't free nodes fast enough.
+ * - arena: blocks of children are carved out of large chunks
+ *   allocated on demand, each thread filling its own chunk.
+ *   After a move, the subtree rooted at the played move stays in
+ *   place and chunks holding none of its nodes are released whole,
+ *   without walking the rest of the tree. (Freeing nodes one by one
+ *   used to be very slow, seen 9s and loss on time because of this.)
+ *   Big releases happen in a background thread.
  *
  * - fast_alloc: a large buffer is allocated once, and each
  *   node allocation takes some of this buffer. After a move
@@ -22,8 +22,10 @@
  *   preference nodes with largest number of playouts.
  *   Then the temporary buffer is copied back to the original
  *   buffer, which has now plenty of space.
- *   Once the fast_alloc mode is proven reliable, the
- *   calloc/free method will be removed. */
+ *   With concurrent gc the temporary buffer is kept up to date
+ *   in the background during the search, so that only the copy
+ *   back remains to be done after a move.
+ *   Local tree nodes are always allocated with calloc. */
 
 #include <stdbool.h>
 #include <pthread.h>
@@ -47,22 +49,28 @@ struct uct;
  * +------+   +------+   +------+   +------+
  */
 
-/* TODO: Performance would benefit from a reorganization:
- * (i) Allocate all children of a node within a single block.
- * (ii) Keep all u stats together, and all amaf stats together.
- * Currently, rave_update is top source of cache misses, and
- * there is large memory overhead for having all nodes separate. */
+/* All children of a node are allocated within a single block, and the
+ * hot statistics (u, amaf and prior) are kept out of the node itself in
+ * per-block arrays placed right after the nodes, so that walking the
+ * children during descent and rave update touches dense memory:
+ *
+ *   +---------+---------+-----+------+------+-----+---------+---------+-----+
+ *   | node[0] | node[1] | ... | u[0] | u[1] | ... | amaf[0] | ... | prior[0] ...
+ *   +---------+---------+-----+------+------+-----+---------+---------+-----+
+ *
+ * Siblings within a block are still chained through sibling pointers.
+ * Root and local tree nodes live in single-node blocks.
+ *
+ * With progressive widening (uct widening option) only children with the
+ * best priors are created at expansion, the other moves are kept pending
+ * in a compact array after the first block (parent has TREE_HINT_PENDING).
+ * As parent playouts grow more children are created in new blocks,
+ * chained after the last child: children are then a list of blocks,
+ * see tree_block_next(). */
 
 typedef struct tree_node {
-	hash_t hash;
 	struct tree_node *parent, *sibling, *children;
 
-	/*** From here on, struct is saved/loaded from opening tbook */
-
-	move_stats_t u;
-	move_stats_t prior;
-	/* XXX: Should be way for policies to add their own stats */
-	move_stats_t amaf;
 	/* Stats before starting playout; used for distributed engine. */
 	move_stats_t pu;
 	/* Criticality information; information about final board owner
@@ -76,6 +84,10 @@ typedef struct tree_node {
 
 	unsigned short depth; // just for statistics
 
+	/* Position of the node within its block, and number of nodes in the block. */
+	unsigned short index;
+	unsigned short count;
+
 	/* Number of parallel descents going through this node at the moment.
 	* Used for virtual loss computation. */
 	signed char descents;
@@ -86,8 +98,13 @@ typedef struct tree_node {
 
 #define TREE_HINT_INVALID 1 // don't go to this node, invalid move
 #define TREE_HINT_DCNN    2 // node has dcnn priors
+#define TREE_HINT_SOLVER  4 // solver checked if game is over (pass node)
+#define TREE_HINT_PENDING 8 // children have pending moves (progressive widening)
 	unsigned char hints;
 
+	/* Proven game result (solver), see tree_solver_update(). */
+	unsigned char proven;
+
 	/* In case multiple threads walk the tree, is_expanded is set
 	* atomically. Only the first thread setting it expands the node.
 	* The node goes through 3 states:
@@ -97,7 +114,71 @@ typedef struct tree_node {
 	bool is_expanded;
 } tree_node_t;
 
+/* Proven results, ordered from black's point of view. */
+enum tree_proven {
+	PROVEN_NONE = 0,
+	PROVEN_WHITE,		/* white wins */
+	PROVEN_DRAW,
+	PROVEN_BLACK,		/* black wins */
+};
+#define proven_win(color)   ((color) == S_BLACK ? PROVEN_BLACK : PROVEN_WHITE)
+#define proven_loss(color)  ((color) == S_BLACK ? PROVEN_WHITE : PROVEN_BLACK)
+
+/* Block layout accessors, see above. */
+#define tree_block_first(n)     ((n) - (n)->index)
+#define tree_block_u(first)     ((move_stats_t *)((first) + (first)->count))
+#define tree_block_amaf(first)  (tree_block_u(first) + (first)->count)
+#define tree_block_prior(first) (tree_block_u(first) + 2 * (first)->count)
+
+/* Next block of children, NULL if last. */
+#define tree_block_next(first)  ((first)[(first)->count - 1].sibling)
+
+/* Progressive widening: moves not created yet, after the first
+ * children block. */
+typedef struct {
+	short coord;
+	unsigned char d;
+	bool taken;		/* child created since */
+	move_stats_t prior;
+} tree_pending_move_t;
+
+typedef struct {
+	int lock;
+	int children;		/* number of children created */
+	int left;		/* pending moves not taken yet */
+	int count;
+	tree_node_t *last;	/* last child, new blocks get linked after it */
+	tree_pending_move_t move[];
+} tree_pending_t;
+
+#define tree_pending_size(count)  (sizeof(tree_pending_t) + (count) * sizeof(tree_pending_move_t))
+#define tree_block_pending(first) ((tree_pending_t *)(tree_block_u(first) + 3 * (first)->count))
+#define tree_node_pending(n)      tree_block_pending((n)->children)
+#define tree_node_has_pending(n)  ((n)->children && ((n)->hints & TREE_HINT_PENDING))
+
+static inline move_stats_t *
+tree_node_stats(const tree_node_t *n)
+{
+	return (move_stats_t *)(n - n->index + n->count) + n->index;
+}
+
+/* Hot node stats, usable as lvalues. */
+#define node_u(n)     (tree_node_stats(n)[0])
+/* XXX: Should be way for policies to add their own stats */
+#define node_amaf(n)  (tree_node_stats(n)[(n)->count])
+#define node_prior(n) (tree_node_stats(n)[2 * (n)->count])
+
 struct tree_hash;
+struct tree_tt;
+struct tree_gc;
+struct tree_arena;
+
+/* Pages backing the fast_alloc nodes buffer. */
+enum tree_huge_pages {
+	TREE_PAGES_REGULAR,
+	TREE_PAGES_THP,		/* transparent huge pages */
+	TREE_PAGES_EXPLICIT,	/* reserved huge pages, fall back to thp */
+};
 
 typedef struct {
 	board_t *board;
@@ -140,18 +221,33 @@ typedef struct {
 	struct tree_hash *htable;
 	int hbits;
 
+	/* Transposition seeding table, maps position hash to the first node
+	 * expanded in that position. NULL unless tt_seed is enabled. */
+	struct tree_tt *tt;
+
+	/* Concurrent garbage collection state, NULL unless enabled. */
+	struct tree_gc *gc;
+	/* Bumped whenever nodes move, invalidates gc snapshots. */
+	unsigned int generation;
+
 	// Statistics
 	int max_depth;
-	volatile size_t nodes_size; // byte size of all allocated nodes
+	volatile size_t nodes_size; // byte size of all allocated nodes (live ones in arena mode)
 	size_t max_tree_size; // maximum byte size for entire tree, > 0 only for fast_alloc
 	size_t max_pruned_size;
 	size_t pruning_threshold;
 	void *nodes; // nodes buffer, only for fast_alloc
+	enum tree_huge_pages huge_pages; // pages asked for nodes buffer (also temp trees)
+	enum tree_huge_pages pages; // pages we got
+	void *nodes_map; // mmap()ed range holding nodes buffer, NULL if malloced
+	size_t nodes_map_size;
+	struct tree_arena *arena; // nodes arena, only for fast_alloc=false
 } tree_t;
 
 /* Warning: all functions below except tree_expand_node & tree_leaf_node are THREAD-UNSAFE! */
-tree_t *tree_init(board_t *board, enum stone color, size_t max_tree_size,
+tree_t *tree_init(board_t *board, enum stone color, size_t max_tree_size, enum tree_huge_pages huge_pages,
 		       size_t max_pruned_size, size_t pruning_threshold, floating_t ltree_aging, int hbits);
+const char *tree_pages_str(enum tree_huge_pages pages);
 void tree_done(tree_t *tree);
 void tree_dump(tree_t *tree, double thres);
 void tree_save(tree_t *tree, board_t *b, int thres);
@@ -160,12 +256,38 @@ void tree_load(tree_t *tree, board_t *b);
 tree_node_t *tree_get_node(tree_node_t *parent, coord_t c);
 tree_node_t *tree_get_node2(tree_t *tree, tree_node_t *parent, coord_t c, bool create);
 tree_node_t *tree_garbage_collect(tree_t *tree, tree_node_t *node);
+/* Discard least visited subtrees to make room (fast_alloc only),
+ * search must be paused. Returns the new root. */
+tree_node_t *tree_recycle(tree_t *tree);
 void tree_promote_node(tree_t *tree, tree_node_t **node);
 bool tree_promote_at(tree_t *tree, board_t *b, coord_t c, int *reason);
 
 void tree_expand_node(tree_t *tree, tree_node_t *node, board_t *b, enum stone color, struct uct *u, int parity);
 tree_node_t *tree_lnode_for_node(tree_t *tree, tree_node_t *ni, tree_node_t *lni, int tenuki_d);
 
+/* Progressive widening: create up to @n more children for @node from
+ * its pending moves, best priors first. */
+void tree_widen_node(tree_t *tree, tree_node_t *node, int n);
+
+/* MCTS solver: propagate @node's proven result to its ancestors.
+ * Returns true if root got proven. */
+bool tree_solver_update(tree_t *tree, tree_node_t *node);
+
+/* Concurrent garbage collection, only for fast_alloc. tree_gc_start/stop
+ * bracket a search, the snapshot taken meanwhile is used by the next
+ * tree_promote_node() instead of tree_garbage_collect() if possible. */
+struct tree_gc *tree_gc_init(tree_t *tree);
+void tree_gc_done(struct tree_gc *gc);
+void tree_gc_start(tree_t *tree);
+void tree_gc_stop(tree_t *tree);
+
+/* Transposition table with 2^bits entries. Entries are dropped whenever
+ * nodes can move or go away (tree promotion, garbage collection). */
+struct tree_tt *tree_tt_init(int bits);
+void tree_tt_done(struct tree_tt *tt);
+void tree_tt_clear(struct tree_tt *tt);
+void tree_tt_print_stats(tree_t *tree);
+
 static bool tree_leaf_node(tree_node_t *node);
 
 #define tree_node_parity(tree, node) \
@@ -175,6 +297,10 @@ static bool tree_leaf_node(tree_node_t *node);
 #define tree_parity(tree, parity) \
 	(tree->root_color == S_WHITE ? (parity) : -1 * (parity))
 
+/* Color of @node's children moves. */
+#define tree_node_children_color(tree, node) \
+	(tree_node_parity(tree, node) > 0 ? stone_other((tree)->root_color) : (tree)->root_color)
+
 /* Get a 0..1 value to maximize; @parity is parity within the tree. */
 #define tree_node_get_value(tree, parity, value) \
 	(tree_parity(tree, parity) > 0 ? value : 1 - value)
@@ -197,8 +323,8 @@ tree_node_criticality(const tree_t *t, const tree_node_t *node)
 	 * = winner_gets - (b_gets * b_wins + 1 - b_gets - b_wins + b_gets * b_wins)
 	 * = winner_gets - (2 * b_gets * b_wins - b_gets - b_wins + 1) */
 	return node->winner_owner.value
-		- (2 * node->black_owner.value * node->u.value
-		   - node->black_owner.value - node->u.value + 1);
+		- (2 * node->black_owner.value * node_u(node).value
+		   - node->black_owner.value - node_u(node).value + 1);
 }
 
 #endif
@@ -12,6 +12,7 @@
 #include "gtp.h"
 #include "chat.h"
 #include "move.h"
+#include "numa.h"
 #include "mq.h"
 #include "joseki.h"
 #include "playout.h"
@@ -40,8 +41,17 @@ static void uct_pondering_start(uct_t *u, board_t *b0, tree_t *t, enum stone col
 static void
 setup_state(uct_t *u, board_t *b, enum stone color)
 {
-	u->t = tree_init(b, color, u->fast_alloc ? u->max_tree_size : 0,
+	u->t = tree_init(b, color, u->fast_alloc ? u->max_tree_size : 0, u->huge_pages,
 			 u->max_pruned_size, u->pruning_threshold, u->local_tree_aging, u->stats_hbits);
+	if (u->huge_pages && u->t->nodes && UDEBUGL(1))
+		fprintf(stderr, "Tree: %lluMb nodes buffer, %s\n",
+			(unsigned long long)u->max_tree_size / 1048576, tree_pages_str(u->t->pages));
+	if (u->numa_interleave && u->t->nodes)
+		numa_mem_interleave(u->t->nodes, u->t->max_tree_size);
+	if (u->tt_seed)
+		u->t->tt = tree_tt_init(u->tt_seed);
+	if (u->concurrent_gc && u->fast_alloc)
+		u->t->gc = tree_gc_init(u->t);
 	if (u->initial_extra_komi)
 		u->t->extra_komi = u->initial_extra_komi;
 	if (u->force_seed)
@@ -242,7 +252,7 @@ uct_result(engine_t *e, board_t *b)
 	tree_node_t *n = u->t->root;
 	snprintf(reply, 1024, "%s %s %d %.2f %.1f",
 		 stone2str(color), coord2sstr(node_coord(n)),
-		 n->u.playouts, tree_node_get_value(u->t, -1, n->u.value),
+		 node_u(n).playouts, tree_node_get_value(u->t, -1, node_u(n).value),
 		 u->t->use_extra_komi ? u->t->extra_komi : 0);
 	return reply;
 }
@@ -256,11 +266,11 @@ uct_chat(engine_t *e, board_t *b, bool opponent, char *from, char *cmd)
 		return generic_chat(b, opponent, from, cmd, S_NONE, pass, 0, 1, u->threads, 0.0, 0.0, "");
 
 	tree_node_t *n = u->t->root;
-	double winrate = tree_node_get_value(u->t, -1, n->u.value);
+	double winrate = tree_node_get_value(u->t, -1, node_u(n).value);
 	double extra_komi = u->t->use_extra_komi && fabs(u->t->extra_komi) >= 0.5 ? u->t->extra_komi : 0;
 	char *score_est = ownermap_score_est_str(b, &u->ownermap);
 
-	return generic_chat(b, opponent, from, cmd, u->t->root_color, node_coord(n), n->u.playouts, 1,
+	return generic_chat(b, opponent, from, cmd, u->t->root_color, node_coord(n), node_u(n).playouts, 1,
 			    u->threads, winrate, extra_komi, score_est);
 }
 
@@ -329,6 +339,7 @@ uct_done(engine_t *e)
 
 	free(u->banner);
 	uct_pondering_stop(u);
+	uct_pool_done(u);
 	if (u->t)             reset_state(u);
 	if (u->dynkomi)       u->dynkomi->done(u->dynkomi);
 	if (u->policy)        u->policy->done(u->policy);
@@ -343,7 +354,7 @@ uct_done(engine_t *e)
 
 
 /* Run time-limited MCTS search on foreground. */
-static int
+int
 uct_search(uct_t *u, board_t *b, time_info_t *ti, enum stone color, tree_t *t, bool print_progress)
 {
 	uct_search_state_t s;
@@ -355,14 +366,12 @@ uct_search(uct_t *u, board_t *b, time_info_t *ti, enum stone color, tree_t *t, b
 	 * to reference ctx->t directly since the
 	 * thread manager will swap the tree pointer asynchronously. */
 
-	/* Now, just periodically poll the search tree. */
+	/* Now, check the search tree whenever a time limit or playout
+	 * milestone is reached, or every TREE_BUSYWAIT_INTERVAL at least. */
 	/* Note that in case of TD_GAMES, threads will not wait for
 	 * the uct_search_check_stop() signalization. */
 	while (1) {
-		time_sleep(TREE_BUSYWAIT_INTERVAL);
-		/* TREE_BUSYWAIT_INTERVAL should never be less than desired time, or the
-		 * time control is broken. But if it happens to be less, we still search
-		 * at least 100ms otherwise the move is completely random. */
+		uct_search_wait(u, ti, &s);
 
 		int i = uct_search_games(&s);
 		/* Print notifications etc. */
@@ -379,6 +388,10 @@ uct_search(uct_t *u, board_t *b, time_info_t *ti, enum stone color, tree_t *t, b
 			t->avg_score.value, t->avg_score.playouts,
 			u->dynkomi->score.value, u->dynkomi->score.playouts,
 			u->dynkomi->value.value, u->dynkomi->value.playouts);
+	if (UDEBUGL(2) && t->tt)
+		tree_tt_print_stats(t);
+	if (UDEBUGL(2))
+		uct_pool_print_numa_stats(u, t);
 	if (print_progress)
 		uct_progress_status(u, t, color, ctx->games, NULL);
 
@@ -387,7 +400,7 @@ uct_search(uct_t *u, board_t *b, time_info_t *ti, enum stone color, tree_t *t, b
 		time_info_t debug_ti;
 		debug_ti.period = TT_MOVE;
 		debug_ti.dim = TD_GAMES;
-		debug_ti.len.games = t->root->u.playouts + u->debug_after.playouts;
+		debug_ti.len.games = node_u(t->root).playouts + u->debug_after.playouts;
 		debug_ti.len.games_max = 0;
 
 		board_print_ownermap(b, stderr, &u->ownermap);
@@ -515,7 +528,7 @@ genmove(engine_t *e, board_t *b, time_info_t *ti, enum stone color, bool pass_al
 	uct_genmove_setup(u, b, color);
 
         /* Start the Monte Carlo Tree Search! */
-	int base_playouts = u->t->root->u.playouts;
+	int base_playouts = node_u(u->t->root).playouts;
 	int played_games = uct_search(u, b, ti, color, u->t, false);
 
 	tree_node_t *best;
@@ -636,12 +649,12 @@ uct_get_best_moves_at(uct_t *u, tree_node_t *parent, coord_t *best_c, float *bes
 	
 	/* Find best moves */
 	for (tree_node_t *n = parent->children; n; n = n->sibling)
-		if (n->u.playouts >= min_playouts)
-			best_moves_add_full(node_coord(n), n->u.playouts, n, best_c, best_r, (void**)best_n, nbest);
+		if (node_u(n).playouts >= min_playouts)
+			best_moves_add_full(node_coord(n), node_u(n).playouts, n, best_c, best_r, (void**)best_n, nbest);
 
 	if (winrates)  /* Get winrates */
 		for (int i = 0; i < nbest && best_n[i]; i++)
-			best_r[i] = tree_node_get_value(u->t, 1, best_n[i]->u.value);
+			best_r[i] = tree_node_get_value(u->t, 1, node_u(best_n[i]).value);
 }
 
 /* Get best moves with at least @min_playouts.
@@ -680,7 +693,7 @@ uct_gentbook(engine_t *e, board_t *b, time_info_t *ti, enum stone color)
 
 	if (ti->dim == TD_GAMES) {
 		/* Don't count in games that already went into the tbook. */
-		ti->len.games += u->t->root->u.playouts;
+		ti->len.games += node_u(u->t->root).playouts;
 	}
 	uct_search(u, b, ti, color, u->t, true);
 
@@ -694,7 +707,7 @@ void
 uct_dumptbook(engine_t *e, board_t *b, enum stone color)
 {
 	uct_t *u = (uct_t*)e->data;
-	tree_t *t = tree_init(b, color, u->fast_alloc ? u->max_tree_size : 0,
+	tree_t *t = tree_init(b, color, u->fast_alloc ? u->max_tree_size : 0, u->huge_pages,
 			      u->max_pruned_size, u->pruning_threshold, u->local_tree_aging, 0);
 	tree_load(t, b);
 	tree_dump(t, 0);
@@ -725,7 +738,7 @@ uct_evaluate_one(engine_t *e, board_t *b, time_info_t *ti, coord_t c, enum stone
 	if (!best) {
 		bestval = NAN; // the opponent has no reply!
 	} else {
-		bestval = tree_node_get_value(u->t, 1, best->u.value);
+		bestval = tree_node_get_value(u->t, 1, node_u(best).value);
 	}
 
 	reset_state(u); // clean our junk
@@ -778,13 +791,21 @@ uct_state_init(char *arg, board_t *b)
 	u->mercymin = 0;
 	u->significant_threshold = 50;
 	u->expand_p = 8;
+	u->widening_playouts = 100;
 	u->dumpthres = 0.01;
 	u->playout_amaf = true;
 	u->amaf_prior = false;
 	u->max_tree_size = default_max_tree_size();
 	u->fast_alloc = true;
 	u->pruning_threshold = 0;
+	u->concurrent_gc = false;
+	u->recycle = false;
+	u->pin_threads = false;
+	u->numa_interleave = false;
+	u->huge_pages = TREE_PAGES_REGULAR;
 	u->genmove_reset_tree = false;
+	u->tt_seed = 0;
+	u->tt_seed_eqex = 40;
 
 	u->threads = get_nprocessors();
 	u->thread_model = TM_TREEVL;
@@ -793,6 +814,7 @@ uct_state_init(char *arg, board_t *b)
 	u->pondering_opt = false;
 	u->dcnn_pondering_prior = 5;
 	u->dcnn_pondering_mcts = 3;
+	u->dcnn_batch = 0;
 
 	u->fuseki_end = 20; // max time at 361*20% = 72 moves (our 36th move, still 99 to play)
 	u->yose_start = 40; // (100-40-25)*361/100/2 = 63 moves still to play by us then
@@ -1005,6 +1027,15 @@ uct_state_init(char *arg, board_t *b)
 				/* Expand UCT nodes after it has been
 				 * visited this many times. */
 				u->expand_p = atoi(optval);
+			} else if (!strcasecmp(optname, "widening") && optval) {
+				/* Progressive widening: create only this many
+				 * children (best priors) when expanding a node,
+				 * more as it gets playouts. 0 to disable. */
+				u->widening = atoi(optval);
+			} else if (!strcasecmp(optname, "widening_playouts") && optval) {
+				/* Progressive widening rate: children allowed
+				 * grow as widening * sqrt(1 + playouts / widening_playouts) */
+				u->widening_playouts = atoi(optval);
 			} else if (!strcasecmp(optname, "random_policy_chance") && optval) {
 				/* If specified (N), with probability 1/N, random_policy policy
 				 * descend is used instead of main policy descend; useful
@@ -1064,6 +1095,8 @@ uct_state_init(char *arg, board_t *b)
 			} else if (!strcasecmp(optname, "max_tree_size") && optval) {
 				/* Maximum amount of memory [MiB] consumed by the move tree.
 				 * For fast_alloc it includes the temp tree used for pruning.
+				 * Without fast_alloc nothing is preallocated, only live nodes
+				 * count (not arena chunks still holding some dead ones).
 				 * Default is 3072 (3 GiB). */
 				u->max_tree_size = (size_t)atoll(optval) * 1048576;  /* long is 4 bytes on windows! */
 			} else if (!strcasecmp(optname, "fast_alloc")) {
@@ -1074,11 +1107,64 @@ uct_state_init(char *arg, board_t *b)
 				 * Increase to reduce pruning time overhead if memory is plentiful.
 				 * This option is meaningful only for fast_alloc. */
 				u->pruning_threshold = atol(optval) * 1048576;
+			} else if (!strcasecmp(optname, "concurrent_gc")) {
+				/* Keep a pruned copy of the tree up to date while
+				 * searching and pondering, so that pruning at the
+				 * next move doesn't have to scan the whole tree.
+				 * Playouts made after the last update are lost.
+				 * Recommended for very large trees (tens of GiB).
+				 * This option is meaningful only for fast_alloc. */
+				u->concurrent_gc = !optval || atoi(optval);
+			} else if (!strcasecmp(optname, "recycle")) {
+				/* When the tree gets full while searching, discard
+				 * least visited subtrees and keep searching instead
+				 * of stopping (long pondering / analysis).
+				 * Off by default, stopping when the tree is full keeps
+				 * search results unchanged.
+				 * This option is meaningful only for fast_alloc. */
+				u->recycle = !optval || atoi(optval);
+			} else if (!strcasecmp(optname, "pin_threads")) {
+				/* Pin search threads to cpus, filling NUMA nodes
+				 * one after the other. Tree nodes are allocated
+				 * by the expanding thread, so they end up in its
+				 * node's memory (first touch). Linux only. */
+				u->pin_threads = !optval || atoi(optval);
+			} else if (!strcasecmp(optname, "numa_interleave")) {
+				/* Interleave tree memory over all NUMA nodes
+				 * instead. Linux, fast_alloc only. */
+				u->numa_interleave = !optval || atoi(optval);
+			} else if (!strcasecmp(optname, "huge_pages")) {
+				/* Back tree memory with huge pages (fast_alloc only),
+				 * fewer TLB misses on large trees:
+				 *   huge_pages / huge_pages=thp:  transparent huge pages
+				 *   huge_pages=explicit:  reserved huge pages (vm.nr_hugepages),
+				 *                         falls back to transparent ones.
+				 * What we got is logged when the tree is created. */
+				if (!optval || !strcasecmp(optval, "thp") || !strcmp(optval, "1"))
+					u->huge_pages = TREE_PAGES_THP;
+				else if (!strcasecmp(optval, "explicit") || !strcmp(optval, "2"))
+					u->huge_pages = TREE_PAGES_EXPLICIT;
+				else if (!strcmp(optval, "0"))
+					u->huge_pages = TREE_PAGES_REGULAR;
+				else
+					die("uct: Invalid huge_pages value %s\n", optval);
 			} else if (!strcasecmp(optname, "reset_tree")) {
 				/* Reset tree before each genmove ?
 				 * Default is to reuse previous tree when not using dcnn. 
 				 * When using dcnn tree is always reset. */
 				u->genmove_reset_tree = !optval || atoi(optval);
+			} else if (!strcasecmp(optname, "tt_seed")) {
+				/* Transposition seeding: nodes expanded in a position
+				 * already seen in the tree (through a different move
+				 * order) start with a copy of the children stats of the
+				 * first node expanded there. Stats are not shared after
+				 * that, each node goes on on its own. Optional value is
+				 * the table size in bits (2^bits entries), default 20. */
+				u->tt_seed = (optval ? atoi(optval) : 20);
+			} else if (!strcasecmp(optname, "tt_seed_eqex") && optval) {
+				/* Maximum playouts carried over from transposed node
+				 * per child, for both u and amaf stats. Default is 40. */
+				u->tt_seed_eqex = atoi(optval);
 
 			/* Pondering */
 
@@ -1106,6 +1192,17 @@ uct_state_init(char *arg, board_t *b)
 				size_t n = u->dcnn_pondering_mcts = atoi(optval);
 				assert(n <= sizeof(u->dcnn_pondering_mcts_c) / sizeof(u->dcnn_pondering_mcts_c[0]));
 
+			/** Dcnn */
+
+			} else if (!strcasecmp(optname, "dcnn_batch") && optval) {
+				/* Dcnn evaluation of nodes expanded during search.
+				 * By default only root node gets dcnn priors. With dcnn_batch=N
+				 * other nodes are dcnn evaluated asynchronously as well: they
+				 * start with regular priors and get dcnn priors once evaluated.
+				 * A separate thread evaluates up to N pending positions at once
+				 * so that search threads don't wait on dcnn. Default is 0 (off). */
+				u->dcnn_batch = atoi(optval);
+
 			/** Time control */
 
 			} else if (!strcasecmp(optname, "best2_ratio") && optval) {
@@ -1300,6 +1397,14 @@ uct_state_init(char *arg, board_t *b)
 				 * some meaningful information in the values
 				 * of the node and its children. */
 				u->significant_threshold = atoi(optval);
+			} else if (!strcasecmp(optname, "solver")) {
+				/* MCTS solver: prove game results when both
+				 * players pass in the tree and the result is
+				 * certain (all stones pass-alive or dead in
+				 * pass-alive areas), and propagate them upwards.
+				 * Proven losses are not explored anymore and
+				 * search stops once root is a proven win. */
+				u->solver = !optval || atoi(optval);
 
 			/** Distributed engine slaves setup */
 #ifdef DISTRIBUTED
@@ -1373,6 +1478,14 @@ uct_state_init(char *arg, board_t *b)
 	if (!!u->random_policy_chance ^ !!u->random_policy)
 		die("uct: Only one of random_policy and random_policy_chance is set\n");
 
+	if (u->widening && (u->local_tree || u->slave)) {
+		/* Local trees and distributed engine expect all children. */
+		if (UDEBUGL(1))  fprintf(stderr, "uct: progressive widening doesn't work with local_tree or slave, disabled.\n");
+		u->widening = 0;
+	}
+	if (u->widening_playouts < 1)
+		u->widening_playouts = 1;
+
 	if (!u->local_tree) {
 		/* No ltree aging. */
 		u->local_tree_aging = 1.0f;
@@ -1389,8 +1502,8 @@ uct_state_init(char *arg, board_t *b)
 		u->max_pruned_size = u->max_tree_size / 5;
 		u->max_tree_size -= u->max_pruned_size;
 	} else {
-		/* Reserve 5% memory in case the background free() are slower
-		 * than the concurrent allocations. */
+		/* Reserve 5% memory in case the background release of the
+		 * old arena is slower than the concurrent allocations. */
 		u->max_tree_size -= u->max_tree_size / 20;
 	}
 
@@ -1398,6 +1511,8 @@ uct_state_init(char *arg, board_t *b)
 	if (!using_dcnn(b))		joseki_load(board_rsize(b));
 	if (!pat_setup)			patterns_init(&u->pc, NULL, false, true);
 	log_nthreads(u);
+	numa_setup();
+	uct_pool_init(u);
 	if (!u->prior)			u->prior = uct_prior_init(NULL, b, u);
 	if (!u->playout)		u->playout = playout_moggy_init(NULL, b);
 	if (!u->playout->debug_level)	u->playout->debug_level = u->debug_level;
@@ -13,6 +13,7 @@
 #include "move.h"
 #include "playout.h"
 #include "random.h"
+#include "tactics/benson.h"
 #include "tactics/util.h"
 #include "uct/dynkomi.h"
 #include "uct/internal.h"
@@ -40,7 +41,7 @@ uct_progress_text(FILE *fh, uct_t *u, tree_t *t, enum stone color, int playouts)
 		return;
 	}
 	fprintf(fh, "[%d] ", playouts);
-	fprintf(fh, "best %.1f%% ", 100 * tree_node_get_value(t, 1, best->u.value));
+	fprintf(fh, "best %.1f%% ", 100 * tree_node_get_value(t, 1, node_u(best).value));
 
 	/* Dynamic komi */
 	if (t->use_extra_komi)
@@ -49,7 +50,7 @@ uct_progress_text(FILE *fh, uct_t *u, tree_t *t, enum stone color, int playouts)
 	/* Best sequence */
 	fprintf(fh, "| seq ");
 	for (int depth = 0; depth < 4; depth++) {
-		if (best && best->u.playouts >= 25) {
+		if (best && node_u(best).playouts >= 25) {
 			fprintf(fh, "%3s ", coord2sstr(node_coord(best)));
 			best = u->policy->choose(u->policy, best, b, color, resign);
 		}
@@ -111,7 +112,7 @@ uct_progress_lz(FILE *fh, uct_t *u, tree_t *t, enum stone color)
 		tree_node_t *n = tree_get_node(node, best_c[i]);
 		while (1) {
 			n = u->policy->choose(u->policy, n, b, color, resign);
-			if (!n || n->u.playouts < 100) break;
+			if (!n || node_u(n).playouts < 100) break;
 			fprintf(fh, "%s ", coord2sstr(node_coord(n)));
 		}
 	}
@@ -129,7 +130,7 @@ uct_progress_gogui_sequence(uct_t *u, tree_t *t, enum stone color, int playouts)
 	tree_node_t *best = u->policy->choose(u->policy, t->root, t->board, color, resign);
 	if (!best) {  fprintf(stderr, "... No moves left\n"); return;  }
 	
-	for (int i = 0; i < n && best && best->u.playouts >= 50; i++) {
+	for (int i = 0; i < n && best && node_u(best).playouts >= 50; i++) {
 		seq[i] = node_coord(best);
 		best = u->policy->choose(u->policy, best, t->board, color, resign);
 	}
@@ -180,7 +181,7 @@ uct_progress_json(FILE *fh, uct_t *u, tree_t *t, enum stone color, int playouts,
 			/* Best move */
 			fprintf(fh, ", \"best\": {\"%s\": %f}",
 				coord2sstr(best->coord),
-				tree_node_get_value(t, 1, best->u.value));
+				tree_node_get_value(t, 1, node_u(best).value));
 		}
 	}
 
@@ -191,7 +192,7 @@ uct_progress_json(FILE *fh, uct_t *u, tree_t *t, enum stone color, int playouts,
 	tree_node_t *best = t->root->children;
 	while (best) {        /* XXX clean this up, use uct_get_best_moves() instead */
 		int c = 0;
-		while ((!can[c] || best->u.playouts > can[c]->u.playouts) && ++c < cans);
+		while ((!can[c] || node_u(best).playouts > node_u(can[c]).playouts) && ++c < cans);
 		for (int d = 0; d < c; d++) can[d] = can[d + 1];
 		if (c > 0) can[c - 1] = best;
 		best = best->sibling;
@@ -203,11 +204,11 @@ uct_progress_json(FILE *fh, uct_t *u, tree_t *t, enum stone color, int playouts,
 		fprintf(fh, "[");
 		best = can[cans];
 		for (int depth = 0; depth < 4; depth++) {
-			if (!best || best->u.playouts < 25) break;
+			if (!best || node_u(best).playouts < 25) break;
 			fprintf(fh, "%s{\"%s\": [%.3f, %i]}", depth > 0 ? "," : "",
 				coord2sstr(best->coord),
-				tree_node_get_value(t, 1, best->u.value),
-				best->u.playouts);
+				tree_node_get_value(t, 1, node_u(best).value),
+				node_u(best).playouts);
 			best = u->policy->choose(u->policy, best, t->board, color, resign);
 		}
 		fprintf(fh, "]%s", cans > 0 ? ", " : "");
@@ -303,8 +304,8 @@ uct_leaf_node(uct_t *u, board_t *b, enum stone player_color,
 
 	if (UDEBUGL(7))
 		fprintf(stderr, "%s*-- UCT playout #%d start [%s] %f\n",
-			spaces, n->u.playouts, coord2sstr(node_coord(n)),
-			tree_node_get_value(t, -parity, n->u.value));
+			spaces, node_u(n).playouts, coord2sstr(node_coord(n)),
+			tree_node_get_value(t, -parity, node_u(n).value));
 
 	playout_setup_t ps = playout_setup(u->gamelen, u->mercymin);
 	int result = playout_play_game(&ps, b, next_color,
@@ -321,6 +322,60 @@ uct_leaf_node(uct_t *u, board_t *b, enum stone player_color,
 	return result;
 }
 
+/* Solver: Score game end position if result is certain: all stones
+ * must be pass-alive or dead in opponent's pass-alive area. Dead stones
+ * estimates (ownermap) are for root position, they prove nothing deeper
+ * in the tree. Result is from black's perspective like uct_leaf_node()'s. */
+static bool
+uct_solver_terminal(board_t *b, int *result)
+{
+	floating_t score;
+	if (!benson_final_score(b, &score))
+		return false;
+	*result = -score * 2;
+	return true;
+}
+
+/* Solver: last move was a pass, so game ends if @n's pass child is
+ * played. Prove it if result is certain (checked once per node). */
+static void
+uct_solver_check_pass(uct_t *u, tree_t *t, tree_node_t *n, board_t *b)
+{
+	tree_node_t *pass_node = n->children;
+	assert(is_pass(node_coord(pass_node)));
+	if (pass_node->proven || (pass_node->hints & TREE_HINT_SOLVER))
+		return;
+	if (__sync_fetch_and_or(&pass_node->hints, TREE_HINT_SOLVER) & TREE_HINT_SOLVER)
+		return;
+
+	int result;
+	if (!uct_solver_terminal(b, &result))
+		return;
+	pass_node->proven = (result > 0 ? PROVEN_BLACK : result < 0 ? PROVEN_WHITE : PROVEN_DRAW);
+	if (tree_solver_update(t, pass_node))
+		uct_search_wakeup(u);  /* Root proven, check search stop. */
+}
+
+/* Progressive widening: create more of @n's children as it gets playouts. */
+static void
+uct_widen(uct_t *u, tree_t *t, tree_node_t *n)
+{
+	tree_pending_t *p = tree_node_pending(n);
+	if (!p->left)
+		return;
+	int allowed = u->widening * sqrt(1 + (double)node_u(n).playouts / u->widening_playouts);
+	int created = p->children - 1;  /* pass doesn't count */
+	if (created < allowed)
+		tree_widen_node(t, n, allowed - created);
+}
+
+/* Proven result, only the winner is known (no score). */
+static int
+proven_result(tree_node_t *n)
+{
+	return (n->proven == PROVEN_BLACK ? 1 : n->proven == PROVEN_WHITE ? -1 : 0);
+}
+
 static floating_t
 scale_value(uct_t *u, board_t *b, enum stone node_color, tree_node_t *significant[2], int result)
 {
@@ -336,7 +391,7 @@ scale_value(uct_t *u, board_t *b, enum stone node_color, tree_node_t *significan
 		if (u->val_bytemp) {
 			/* xvalue is 0 at 0.5, 1 at 0 or 1 */
 			/* No correction for parity necessary. */
-			double xvalue = significant[node_color - 1] ? fabs(significant[node_color - 1]->u.value - 0.5) * 2 : 0;
+			double xvalue = significant[node_color - 1] ? fabs(node_u(significant[node_color - 1]).value - 0.5) * 2 : 0;
 			scale = u->val_bytemp_min + (u->val_scale - u->val_bytemp_min) * xvalue;
 		}
 
@@ -395,7 +450,7 @@ record_local_sequence(uct_t *u, tree_t *t, board_t *endb,
 
 	/* Pick the right local tree root... */
 	tree_node_t *lnode = seq_color == S_BLACK ? t->ltree_black : t->ltree_white;
-	lnode->u.playouts++;
+	node_u(lnode).playouts++;
 
 	/* ...determine the sequence value... */
 	double sval = 0.5;
@@ -435,7 +490,7 @@ record_local_sequence(uct_t *u, tree_t *t, board_t *endb,
 			stone2str(color), rval, descent[di].node->d);
 		lnode = tree_get_node2(t, lnode, node_coord(descent[di++].node), true);
 		assert(lnode);
-		stats_add_result(&lnode->u, rval, pval);
+		stats_add_result(&node_u(lnode), rval, pval);
 	}
 
 	/* Add lnode for tenuki (pass) if we descended further. */
@@ -444,7 +499,7 @@ record_local_sequence(uct_t *u, tree_t *t, board_t *endb,
 		LTREE_DEBUG fprintf(stderr, "pass ");
 		lnode = tree_get_node2(t, lnode, pass, true);
 		assert(lnode);
-		stats_add_result(&lnode->u, rval, pval);
+		stats_add_result(&node_u(lnode), rval, pval);
 	}
 	
 	LTREE_DEBUG fprintf(stderr, "\n");
@@ -479,7 +534,7 @@ uct_playout_descent(uct_t *u, board_t *b, board_t *b2, enum stone player_color,
 	 * with higher than configured number of playouts). For black
 	 * and white. */
 	tree_node_t *significant[2] = { NULL, NULL };
-	if (n->u.playouts >= u->significant_threshold)
+	if (node_u(n).playouts >= u->significant_threshold)
 		significant[node_color - 1] = n;
 
 	int result;
@@ -490,11 +545,18 @@ uct_playout_descent(uct_t *u, board_t *b, board_t *b2, enum stone player_color,
 	static char spaces[] = "\0                                                      ";
 	/* /debug */
 	if (UDEBUGL(8))
-		fprintf(stderr, "--- (#%d) UCT walk with color %d\n", t->root->u.playouts, player_color);
+		fprintf(stderr, "--- (#%d) UCT walk with color %d\n", node_u(t->root).playouts, player_color);
 
-	while (!tree_leaf_node(n) && passes < 2) {
+	/* Proven nodes (solver) need no further descent or playout. */
+	while (!tree_leaf_node(n) && passes < 2 && !(n->proven && n != t->root)) {
 		spaces[dlen - 1] = ' '; spaces[dlen] = 0;
 
+		if (u->solver && passes)
+			uct_solver_check_pass(u, t, n, b2);
+
+		if (u->widening && tree_node_has_pending(n))
+			uct_widen(u, t, n);
+
 
 		/*** Choose a node to descend to: */
 
@@ -520,7 +582,7 @@ uct_playout_descent(uct_t *u, board_t *b, board_t *b2, enum stone player_color,
 
 		/*** Perform the descent: */
 
-		if (descent[dlen].node->u.playouts >= u->significant_threshold)
+		if (node_u(descent[dlen].node).playouts >= u->significant_threshold)
 			significant[node_color - 1] = descent[dlen].node;
 
 		seq_value.playouts += descent[dlen].value.playouts;
@@ -530,8 +592,8 @@ uct_playout_descent(uct_t *u, board_t *b, board_t *b2, enum stone player_color,
 		if (UDEBUGL(7))
 			fprintf(stderr, "%s+-- UCT sent us to [%s:%d] %d,%f\n",
 			        spaces, coord2sstr(node_coord(n)),
-				node_coord(n), n->u.playouts,
-				tree_node_get_value(t, parity, n->u.value));
+				node_coord(n), node_u(n).playouts,
+				tree_node_get_value(t, parity, node_u(n).value));
 
 		if (u->virtual_loss)
 			__sync_fetch_and_add(&n->descents, u->virtual_loss);
@@ -543,7 +605,7 @@ uct_playout_descent(uct_t *u, board_t *b, board_t *b2, enum stone player_color,
 		    || b2->superko_violation) {
 			if (UDEBUGL(4)) {
 				for (tree_node_t *ni = n; ni; ni = ni->parent)
-					fprintf(stderr, "%s<%" PRIhash "> ", coord2sstr(node_coord(ni)), ni->hash);
+					fprintf(stderr, "%s<%p> ", coord2sstr(node_coord(ni)), ni);
 				fprintf(stderr, "marking invalid %s node %d,%d res %d group %d spk %d\n",
 				        stone2str(node_color), coord_x(node_coord(n)), coord_y(node_coord(n)),
 					res, group_at(b2, m.coord), b2->superko_violation);
@@ -568,14 +630,15 @@ uct_playout_descent(uct_t *u, board_t *b, board_t *b2, enum stone player_color,
 		 * The size test must be before the test&set not after, to allow
 		 * expansion of the node later if enough nodes have been freed. */
 		if (tree_leaf_node(n)
-		    && n->u.playouts - u->virtual_loss >= u->expand_p && t->nodes_size < u->max_tree_size
+		    && node_u(n).playouts - u->virtual_loss >= u->expand_p && t->nodes_size < u->max_tree_size
 		    && !__sync_lock_test_and_set(&n->is_expanded, 1))
 			tree_expand_node(t, n, b2, next_color, u, -parity);
 	}
 
 	amaf.game_baselen = amaf.gamelen;
 
-	if (t->use_extra_komi && u->dynkomi->persim)
+	bool proven = (n->proven && n != t->root);
+	if (t->use_extra_komi && u->dynkomi->persim && !proven)
 		b2->komi += round(u->dynkomi->persim(u->dynkomi, b2, t, n));
 
 	/* !!! !!! !!!
@@ -587,7 +650,10 @@ uct_playout_descent(uct_t *u, board_t *b, board_t *b2, enum stone player_color,
 	// assert(tree_leaf_node(n));
 	/* In case of parallel tree search, the assertion might
 	 * not hold if two threads chew on the same node. */
-	result = uct_leaf_node(u, b2, player_color, &amaf, descent, &dlen, significant, t, n, node_color, spaces);
+	if (proven)
+		result = proven_result(n);
+	else
+		result = uct_leaf_node(u, b2, player_color, &amaf, descent, &dlen, significant, t, n, node_color, spaces);
 
 	if (u->policy->wants_amaf && u->playout_amaf_cutoff) {
 		unsigned int cutoff = amaf.game_baselen;
@@ -598,9 +664,16 @@ uct_playout_descent(uct_t *u, board_t *b, board_t *b2, enum stone player_color,
 	/* Record the result. */
 
 	assert(n == t->root || n->parent);
-	floating_t rval = scale_value(u, b, node_color, significant, result);
+	floating_t rval = (proven ? (result > 0 ? 1.0 : result < 0 ? 0.0 : 0.5) :
+			   scale_value(u, b, node_color, significant, result));
 	u->policy->update(u->policy, t, n, node_color, player_color, &amaf, b2, rval);
 
+	/* No game was played, don't pollute score stats. */
+	if (proven) {
+		*presult = result;
+		return n;
+	}
+
 	stats_add_result(&t->avg_score, (float)result / 2, 1);
 	if (t->use_extra_komi) {
 		stats_add_result(&u->dynkomi->score, (float)result / 2, 1);
@@ -665,7 +738,11 @@ int
 uct_playouts(uct_t *u, board_t *b, enum stone color, tree_t *t, time_info_t *ti)
 {
 	int i;
-	for (i = 0; !uct_halt; i++)
+	for (i = 0; !uct_halt; i++) {
+		if (unlikely(u->pause))
+			uct_worker_pause(u);
 		uct_playout(u, b, color, t);
+		uct_search_milestone(u, t);
+	}
 	return i;
 }